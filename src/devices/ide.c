@@ -432,7 +432,7 @@ static void select_device(const struct ata_disk* d) {
     dev |= DEV_DEV;
   outb(reg_device(c), dev);
   inb(reg_alt_status(c));
-  timer_nsleep(400);
+  timer_ndelay(400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL 0x43                        /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL)) /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -75,3 +72,45 @@ void pit_configure_channel(int channel, int mode, int frequency) {
   outb(PIT_PORT_COUNTER(channel), count >> 8);
   intr_set_level(old_level);
 }
+
+/* Configures CHANNEL for a single countdown of COUNT PIT cycles
+   (mode 0, "interrupt on terminal count").  The channel's output
+   goes low now and rises once, when the count runs out; on
+   channel 0 that edge raises one timer interrupt, after which
+   the channel stays quiet until it is reconfigured.  Loading a
+   new count restarts the countdown. */
+void pit_configure_oneshot(int channel, unsigned count) {
+  enum intr_level old_level;
+
+  ASSERT(channel == 0 || channel == 2);
+  ASSERT(count >= 1 && count <= PIT_COUNT_MAX);
+
+  old_level = intr_disable();
+  outb(PIT_PORT_CONTROL, (channel << 6) | 0x30 | (0 << 1));
+  outb(PIT_PORT_COUNTER(channel), count);
+  outb(PIT_PORT_COUNTER(channel), count >> 8);
+  intr_set_level(old_level);
+}
+
+/* Returns the current value of CHANNEL's down-counter.  If
+   OUTPUT is non-null, also stores the state of the channel's
+   output pin in *OUTPUT; in mode 0, it is true once the count has
+   run out.  Both are latched together with a single read-back
+   command, so they are consistent with each other. */
+unsigned pit_read_counter(int channel, bool* output) {
+  enum intr_level old_level;
+  uint8_t status, lo, hi;
+
+  ASSERT(channel == 0 || channel == 2);
+
+  old_level = intr_disable();
+  outb(PIT_PORT_CONTROL, 0xc0 | (1 << (channel + 1)));
+  status = inb(PIT_PORT_COUNTER(channel));
+  lo = inb(PIT_PORT_COUNTER(channel));
+  hi = inb(PIT_PORT_COUNTER(channel));
+  intr_set_level(old_level);
+
+  if (output != NULL)
+    *output = (status & 0x80) != 0;
+  return lo | (hi << 8);
+}
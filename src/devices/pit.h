@@ -1,8 +1,18 @@
 #ifndef DEVICES_PIT_H
 #define DEVICES_PIT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* PIT cycles per second. */
+#define PIT_HZ 1193180
+
+/* Largest count the PIT can be loaded with.  (A count of 0 is
+   treated as 65536, but we don't rely on that.) */
+#define PIT_COUNT_MAX 65535
+
 void pit_configure_channel(int channel, int mode, int frequency);
+void pit_configure_oneshot(int channel, unsigned count);
+unsigned pit_read_counter(int channel, bool* output);
 
 #endif /* devices/pit.h */
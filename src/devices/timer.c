@@ -4,9 +4,14 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
+#include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#ifdef USERPROG
+#include "userprog/vdso.h"
+#endif
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -20,15 +25,47 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* Dynamic ticks.  If true, set by the kernel command-line option
+   "-tickless", the idle thread stops the periodic timer
+   interrupt while nothing is due, and the ticks it skipped are
+   accounted for all at once on the next interrupt. */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define PIT_COUNTS_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks a single one-shot countdown can cover. */
+#define TICKLESS_MAX_TICKS (PIT_COUNT_MAX / PIT_COUNTS_PER_TICK)
+
+/* Ticks that will have elapsed when the armed one-shot
+   countdown runs out, or 0 if the timer is periodic. */
+static int64_t tickless_pending;
+
+/* Number of timer interrupts taken, which in tickless mode can
+   be far fewer than the number of ticks. */
+static int64_t timer_interrupts;
+
+/* Time-stamp counter frequency in kHz, and its value when it
+   was measured.  Initialized by timer_calibrate(). */
+static uint64_t tsc_khz;
+static uint64_t tsc_boot;
+
+/* Keyboard controller port B, which gates PIT channel 2 and
+   reports its output. */
+#define PORT_B 0x61
+#define PORT_B_GATE2 0x01   /* Channel 2 counts while set. */
+#define PORT_B_SPEAKER 0x02 /* Channel 2 drives the speaker while set. */
+#define PORT_B_OUT2 0x20    /* Channel 2 output. */
+
+/* PIT cycles to time the TSC against: about 10 ms. */
+#define TSC_CALIBRATE_COUNT (PIT_HZ / 100)
 
 static intr_handler_func timer_interrupt;
-static bool too_many_loops(unsigned loops);
-static void busy_wait(int64_t loops);
+static void tsc_delay(uint64_t cycles);
+static void pit_delay(uint64_t cycles);
 static void real_time_sleep(int64_t num, int32_t denom);
 static void real_time_delay(int64_t num, int32_t denom);
+static void timer_advance(int64_t cnt);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -37,28 +74,53 @@ void timer_init(void) {
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates the time-stamp counter, used for timer_now() and to
+   implement brief delays, against a single countdown of PIT
+   channel 2. */
 void timer_calibrate(void) {
-  unsigned high_bit, test_bit;
+  enum intr_level old_level;
+  uint8_t port_b;
+  uint64_t start, end;
 
-  ASSERT(intr_get_level() == INTR_ON);
   printf("Calibrating timer...  ");
 
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops(loops_per_tick << 1)) {
-    loops_per_tick <<= 1;
-    ASSERT(loops_per_tick != 0);
-  }
+  old_level = intr_disable();
+  port_b = inb(PORT_B);
+  outb(PORT_B, (port_b & ~PORT_B_SPEAKER) | PORT_B_GATE2);
+  pit_configure_oneshot(2, TSC_CALIBRATE_COUNT);
+  start = rdtsc();
+  while ((inb(PORT_B) & PORT_B_OUT2) == 0)
+    continue;
+  end = rdtsc();
+  outb(PORT_B, port_b);
+  intr_set_level(old_level);
+
+  tsc_khz = (end - start) * PIT_HZ / (TSC_CALIBRATE_COUNT * 1000);
+  if (tsc_khz == 0)
+    tsc_khz = 1;
+  tsc_boot = start;
+#ifdef USERPROG
+  vdso_set_tsc(tsc_khz, tsc_boot);
+#endif
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops(loops_per_tick | test_bit))
-      loops_per_tick |= test_bit;
+  printf("%'" PRIu64 " kHz TSC.\n", tsc_khz);
+}
 
-  printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+/* Returns the number of nanoseconds since timer_calibrate(), with
+   the resolution of the time-stamp counter.  Unlike
+   timer_ticks(), it never goes backward across CPU sleeps and
+   does not depend on timer interrupts being delivered. */
+int64_t timer_now(void) { return timer_tsc_to_ns(rdtsc() - tsc_boot); }
+
+/* Converts CYCLES of the time-stamp counter to nanoseconds.
+   Returns 0 before timer_calibrate() has run. */
+int64_t timer_tsc_to_ns(uint64_t cycles) {
+  if (tsc_khz == 0)
+    return 0;
+
+  /* Split the conversion so that CYCLES * 1,000,000 can't
+     overflow. */
+  return cycles / tsc_khz * 1000000 + cycles % tsc_khz * 1000000 / tsc_khz;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -139,49 +201,131 @@ void timer_udelay(int64_t us) { real_time_delay(us, 1000 * 1000); }
    instead if interrupts are enabled.*/
 void timer_ndelay(int64_t ns) { real_time_delay(ns, 1000 * 1000 * 1000); }
 
+/* Called by the idle thread, with interrupts off, just before
+   it halts.  If dynamic ticks are enabled and nothing needs the
+   timer for at least two ticks, replaces the periodic interrupt
+   by a one-shot countdown to the next tick at which something is
+   due.  The countdown ends on a tick boundary, so the tick phase
+   is kept. */
+void timer_tickless_enter(void) {
+  int64_t cnt;
+  unsigned count;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (!timer_tickless || tickless_pending != 0)
+    return;
+
+  cnt = thread_ticks_until_next_event(TICKLESS_MAX_TICKS);
+  if (cnt < 2)
+    return;
+
+  /* The periodic counter holds what is left of the current tick;
+     add whole ticks after it. */
+  count = pit_read_counter(0, NULL) + (cnt - 1) * PIT_COUNTS_PER_TICK;
+  pit_configure_oneshot(0, count);
+  tickless_pending = cnt;
+}
+
+/* Called by the scheduler, with interrupts off, when it switches
+   away from the idle thread.  Something other than the timer woke
+   the CPU and there is work to do, so a long one-shot countdown
+   is cut short to end at the next tick boundary.  The timer
+   interrupt at that boundary catches up the ticks that were
+   skipped and goes back to periodic mode. */
+void timer_tickless_exit(void) {
+  unsigned remaining, count;
+  bool expired;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (tickless_pending == 0)
+    return;
+
+  remaining = pit_read_counter(0, &expired);
+  if (expired || remaining <= PIT_COUNTS_PER_TICK)
+    return;
+
+  count = (remaining - 1) % PIT_COUNTS_PER_TICK + 1;
+  pit_configure_oneshot(0, count);
+  tickless_pending -= (remaining - count) / PIT_COUNTS_PER_TICK;
+}
+
 /* Prints timer statistics. */
-void timer_print_stats(void) { printf("Timer: %" PRId64 " ticks\n", timer_ticks()); }
+void timer_print_stats(void) {
+  printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+  if (timer_tickless)
+    printf("Timer: %" PRId64 " interrupts\n", timer_interrupts);
+}
 
 /* Timer interrupt handler. */
 static void timer_interrupt(struct intr_frame* args UNUSED) {
-  ticks++;
-  enum intr_level previous_interrupt_level = intr_disable();
-
-  wake_sleeping_threads(); // Added by Jimmy for Project 2. Deals with unblocking threads that have gone past their timer and modifying sleeping_threads_list.
+  int64_t cnt = 1;
+
+  timer_interrupts++;
+  if (tickless_pending != 0) {
+    bool expired;
+
+    /* A periodic interrupt that was already pending when the
+       one-shot was armed accounts for just one tick. */
+    pit_read_counter(0, &expired);
+    if (expired) {
+      cnt = tickless_pending;
+      tickless_pending = 0;
+      pit_configure_channel(0, 2, TIMER_FREQ);
+    }
+  }
 
-  thread_tick();
-  intr_set_level(previous_interrupt_level);
+  timer_advance(cnt);
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool too_many_loops(unsigned loops) {
-  /* Wait for a timer tick. */
-  int64_t start = ticks;
-  while (ticks == start)
-    barrier();
+/* Advances the tick count by CNT ticks, doing the per-tick work
+   for each, as if CNT timer interrupts had just arrived. */
+static void timer_advance(int64_t cnt) {
+  while (cnt-- > 0) {
+    ticks++;
+    enum intr_level previous_interrupt_level = intr_disable();
 
-  /* Run LOOPS loops. */
-  start = ticks;
-  busy_wait(loops);
+    wake_sleeping_threads(); // Added by Jimmy for Project 2. Unblocks threads whose wakeup time has passed.
 
-  /* If the tick count changed, we iterated too long. */
-  barrier();
-  return start != ticks;
+    thread_tick();
+    intr_set_level(previous_interrupt_level);
+  }
+#ifdef USERPROG
+  vdso_set_ticks(ticks);
+#endif
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Spins until the time-stamp counter has advanced by CYCLES. */
+static void tsc_delay(uint64_t cycles) {
+  uint64_t start = rdtsc();
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE busy_wait(int64_t loops) {
-  while (loops-- > 0)
+  while (rdtsc() - start < cycles)
     barrier();
 }
 
+/* Spins for CYCLES of the PIT's input clock, counted down on
+   channel 2 as in timer_calibrate().  For delays before the TSC
+   has been calibrated, such as on the way to shutting down after
+   an early panic. */
+static void pit_delay(uint64_t cycles) {
+  enum intr_level old_level;
+  uint8_t port_b;
+
+  old_level = intr_disable();
+  port_b = inb(PORT_B);
+  outb(PORT_B, (port_b & ~PORT_B_SPEAKER) | PORT_B_GATE2);
+  while (cycles > 0) {
+    unsigned count = cycles < PIT_COUNT_MAX ? cycles : PIT_COUNT_MAX;
+    pit_configure_oneshot(2, count);
+    while ((inb(PORT_B) & PORT_B_OUT2) == 0)
+      continue;
+    cycles -= count;
+  }
+  outb(PORT_B, port_b);
+  intr_set_level(old_level);
+}
+
 /* Sleep for approximately NUM/DENOM seconds. */
 static void real_time_sleep(int64_t num, int32_t denom) {
   /* Convert NUM/DENOM seconds into timer ticks, rounding down.
@@ -207,8 +351,15 @@ static void real_time_sleep(int64_t num, int32_t denom) {
 
 /* Busy-wait for approximately NUM/DENOM seconds. */
 static void real_time_delay(int64_t num, int32_t denom) {
-  /* Scale the numerator and denominator down by 1000 to avoid
-     the possibility of overflow. */
+  /* Count in kHz, so scale the denominator down by 1000 to
+     match, rounding up so that we never wait too little.  Until
+     timer_calibrate() has run, the TSC rate is unknown, so count
+     PIT cycles instead. */
   ASSERT(denom % 1000 == 0);
-  busy_wait(loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
+  if (num <= 0)
+    return;
+  if (tsc_khz != 0)
+    tsc_delay(DIV_ROUND_UP(num * tsc_khz, denom / 1000));
+  else
+    pit_delay(DIV_ROUND_UP(num * (PIT_HZ / 1000), denom / 1000));
 }
@@ -2,6 +2,7 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +13,8 @@ void timer_calibrate(void);
 
 int64_t timer_ticks(void);
 int64_t timer_elapsed(int64_t);
+int64_t timer_now(void);
+int64_t timer_tsc_to_ns(uint64_t cycles);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep(int64_t ticks);
@@ -24,6 +27,11 @@ void timer_mdelay(int64_t milliseconds);
 void timer_udelay(int64_t microseconds);
 void timer_ndelay(int64_t nanoseconds);
 
+/* Dynamic ticks. */
+extern bool timer_tickless;
+void timer_tickless_enter(void);
+void timer_tickless_exit(void);
+
 void timer_print_stats(void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,108 @@
+/* pmatmul.c
+
+   Multiplies a lower-triangular matrix by a square one, so that
+   the cost of an output row grows with its index, first with the
+   rows split statically into one block per thread and then with
+   parallel_for() from the work-stealing task runtime.  Prints the
+   time each takes and how many tasks each worker ran, to compare
+   how well the two balance irregular work.
+
+   Usage: pmatmul [WORKERS] */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <task.h>
+
+#define DIM 96
+
+static int A[DIM][DIM];
+static int B[DIM][DIM];
+static int C[DIM][DIM];
+static int expected[DIM][DIM];
+
+static int workers;
+
+/* Computes rows [LO, HI) of C.  Row I of A has I + 1 nonzero
+   entries, so later rows cost more. */
+static void multiply_rows(int lo, int hi, void* aux UNUSED) {
+  for (int i = lo; i < hi; i++)
+    for (int j = 0; j < DIM; j++) {
+      int sum = 0;
+      for (int k = 0; k <= i; k++)
+        sum += A[i][k] * B[k][j];
+      C[i][j] = sum;
+    }
+}
+
+/* Thread function for the static version: computes the block of
+   rows given by the thread's index in *ARG_. */
+static void static_block(void* arg_) {
+  int idx = *(int*)arg_;
+  int block = (DIM + workers - 1) / workers;
+  int lo = idx * block;
+  int hi = lo + block < DIM ? lo + block : DIM;
+
+  if (lo < hi)
+    multiply_rows(lo, hi, NULL);
+}
+
+/* Checks C against the expected product. */
+static void check(const char* name) {
+  if (memcmp(C, expected, sizeof C))
+    printf("pmatmul: %s: wrong result\n", name);
+  memset(C, 0, sizeof C);
+}
+
+int main(int argc, char* argv[]) {
+  int idx[TASK_WORKERS_MAX];
+  void* args[TASK_WORKERS_MAX];
+  tid_t tids[TASK_WORKERS_MAX];
+  uint64_t start;
+
+  workers = argc > 1 ? atoi(argv[1]) : 4;
+  if (workers < 1 || workers > TASK_WORKERS_MAX) {
+    printf("pmatmul: WORKERS must be between 1 and %d\n", TASK_WORKERS_MAX);
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 0; i < DIM; i++)
+    for (int j = 0; j < DIM; j++) {
+      A[i][j] = j <= i ? i + j : 0;
+      B[i][j] = i - j;
+    }
+  multiply_rows(0, DIM, NULL);
+  memcpy(expected, C, sizeof C);
+  memset(C, 0, sizeof C);
+
+  /* One block of rows per thread. */
+  start = rdtsc();
+  for (int i = 0; i < workers; i++) {
+    idx[i] = i;
+    args[i] = &idx[i];
+  }
+  if (pthread_create_many(static_block, args, workers, tids) != workers ||
+      !pthread_join_all(tids, workers)) {
+    printf("pmatmul: thread creation failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("static blocks:  %llu cycles\n", rdtsc() - start);
+  check("static blocks");
+
+  /* One task per row, balanced by stealing. */
+  start = rdtsc();
+  if (!task_runtime_init(workers)) {
+    printf("pmatmul: task runtime failed to start\n");
+    return EXIT_FAILURE;
+  }
+  parallel_for(0, DIM, 1, multiply_rows, NULL);
+  printf("work stealing:  %llu cycles\n", rdtsc() - start);
+  task_runtime_print_stats();
+  task_runtime_shutdown();
+  check("work stealing");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/* pmsort.c
+
+   Sorts an array of pseudo-random integers with a parallel merge
+   sort built on task_spawn() and task_sync(), once on a single
+   worker and once on WORKERS, and prints the time each takes and
+   how many tasks each worker ran.  The merges are sequential, so
+   the available parallelism shrinks towards the top of the
+   recursion, which makes the load irregular.
+
+   Usage: pmsort [WORKERS] */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <task.h>
+
+#define SORT_SIZE 8192
+
+/* Ranges this short are insertion sorted. */
+#define CUTOFF 32
+
+static int array[SORT_SIZE];
+static int scratch[SORT_SIZE];
+
+/* A range of ARRAY to sort. */
+struct range {
+  int lo, hi;
+};
+
+/* Insertion sorts ARRAY[LO, HI). */
+static void insertion_sort(int lo, int hi) {
+  for (int i = lo + 1; i < hi; i++) {
+    int x = array[i];
+    int j;
+    for (j = i; j > lo && array[j - 1] > x; j--)
+      array[j] = array[j - 1];
+    array[j] = x;
+  }
+}
+
+/* Merges the sorted ranges ARRAY[LO, MID) and ARRAY[MID, HI). */
+static void merge(int lo, int mid, int hi) {
+  int i = lo, j = mid, k = lo;
+
+  while (i < mid && j < hi)
+    scratch[k++] = array[i] <= array[j] ? array[i++] : array[j++];
+  while (i < mid)
+    scratch[k++] = array[i++];
+  while (j < hi)
+    scratch[k++] = array[j++];
+  memcpy(array + lo, scratch + lo, (hi - lo) * sizeof *array);
+}
+
+/* Task function: sorts the range *R_, sorting its upper half as a
+   separate task. */
+static void sort_range(void* r_) {
+  struct range* r = r_;
+  struct range lower, upper;
+  struct task_group g;
+  struct task task;
+  int mid;
+
+  if (r->hi - r->lo <= CUTOFF) {
+    insertion_sort(r->lo, r->hi);
+    return;
+  }
+
+  mid = r->lo + (r->hi - r->lo) / 2;
+  lower.lo = r->lo;
+  lower.hi = upper.lo = mid;
+  upper.hi = r->hi;
+
+  task_group_init(&g);
+  task_spawn(&g, &task, sort_range, &upper);
+  sort_range(&lower);
+  task_sync(&g);
+  merge(r->lo, mid, r->hi);
+}
+
+/* Sorts ARRAY, filled from SEED, with N workers and prints the
+   time taken.  Returns false if the array comes out unsorted. */
+static bool run(int n, unsigned seed) {
+  struct range all = {0, SORT_SIZE};
+  uint64_t start;
+
+  random_init(seed);
+  for (int i = 0; i < SORT_SIZE; i++)
+    array[i] = random_ulong() % 100000;
+
+  start = rdtsc();
+  if (!task_runtime_init(n)) {
+    printf("pmsort: task runtime failed to start\n");
+    return false;
+  }
+  sort_range(&all);
+  printf("%d worker(s): %llu cycles\n", n, rdtsc() - start);
+  task_runtime_print_stats();
+  task_runtime_shutdown();
+
+  for (int i = 1; i < SORT_SIZE; i++)
+    if (array[i - 1] > array[i]) {
+      printf("pmsort: array not sorted at %d\n", i);
+      return false;
+    }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  int workers = argc > 1 ? atoi(argv[1]) : 4;
+
+  if (workers < 1 || workers > TASK_WORKERS_MAX) {
+    printf("pmsort: WORKERS must be between 1 and %d\n", TASK_WORKERS_MAX);
+    return EXIT_FAILURE;
+  }
+  if (!run(1, 162) || !run(workers, 162))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+/* sysbench.c
+
+   Measures the latency of a trivial system call, practice(),
+   entering the kernel by int $0x30 and then by SYSENTER, and
+   prints the average cost of each in CPU cycles.
+
+   Usage: sysbench [CALLS] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Makes CALLS calls to practice() and returns the average number
+   of cycles each took. */
+static uint64_t time_calls(int calls) {
+  uint64_t start = rdtsc();
+
+  for (int i = 0; i < calls; i++)
+    if (practice(i) != i + 1) {
+      printf("sysbench: practice() returned the wrong value\n");
+      exit(EXIT_FAILURE);
+    }
+  return (rdtsc() - start) / calls;
+}
+
+int main(int argc, char* argv[]) {
+  int calls = argc > 1 ? atoi(argv[1]) : 10000;
+
+  if (calls < 1) {
+    printf("sysbench: CALLS must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  syscall_sysenter = false;
+  printf("int $0x30: %llu cycles per call\n", time_calls(calls));
+
+  if (!sysenter_available()) {
+    printf("SYSENTER:  not supported\n");
+    return EXIT_SUCCESS;
+  }
+  syscall_sysenter = true;
+  printf("SYSENTER:  %llu cycles per call\n", time_calls(calls));
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/* threadbench.c
+
+   Measures the cost of creating and joining threads, and prints
+   the average in CPU cycles per thread.  One-at-a-time creation
+   finds the previous thread's page in the kernel's thread page
+   cache every time, while bursts of BURST threads run past the
+   cache and have to allocate the rest.  The kernel's shutdown
+   statistics report how many thread pages came from each.
+
+   Usage: threadbench [ROUNDS] */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/* Threads created at once in the burst test: more than the 16
+   pages the kernel caches. */
+#define BURST 32
+
+static void do_nothing(void* aux UNUSED) {}
+
+/* Creates and joins one thread ROUNDS times and returns the
+   average cycles per thread. */
+static uint64_t time_one_at_a_time(int rounds) {
+  uint64_t start = rdtsc();
+
+  for (int i = 0; i < rounds; i++) {
+    tid_t tid = pthread_create(do_nothing, NULL);
+    if (tid == TID_ERROR || !pthread_join(tid)) {
+      printf("threadbench: could not create and join a thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  return (rdtsc() - start) / rounds;
+}
+
+/* Creates BURST threads and then joins them, ROUNDS times, and
+   returns the average cycles per thread. */
+static uint64_t time_bursts(int rounds) {
+  tid_t tids[BURST];
+  uint64_t start = rdtsc();
+
+  for (int i = 0; i < rounds; i++) {
+    for (int j = 0; j < BURST; j++) {
+      tids[j] = pthread_create(do_nothing, NULL);
+      if (tids[j] == TID_ERROR) {
+        printf("threadbench: could not create %d threads\n", BURST);
+        exit(EXIT_FAILURE);
+      }
+    }
+    for (int j = 0; j < BURST; j++)
+      if (!pthread_join(tids[j])) {
+        printf("threadbench: could not join a thread\n");
+        exit(EXIT_FAILURE);
+      }
+  }
+  return (rdtsc() - start) / ((uint64_t)rounds * BURST);
+}
+
+int main(int argc, char* argv[]) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 100;
+
+  if (rounds < 1) {
+    printf("threadbench: ROUNDS must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("one at a time:     %llu cycles per thread\n", time_one_at_a_time(rounds * BURST));
+  printf("bursts of %d:      %llu cycles per thread\n", BURST, time_bursts(rounds));
+  return EXIT_SUCCESS;
+}
@@ -5,6 +5,7 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -19,6 +20,14 @@ struct dir_entry {
   bool in_use;                 /* In use or free? */
 };
 
+/* Serializes lookups and changes of directory entries, so that
+   two creates of one name cannot both succeed and a lookup never
+   sees a half-written entry. */
+static struct lock dir_lock;
+
+/* Initializes the directory module. */
+void dir_init(void) { lock_init(&dir_lock); }
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool dir_create(block_sector_t sector, size_t entry_cnt) {
@@ -98,10 +107,12 @@ bool dir_lookup(const struct dir* dir, const char* name, struct inode** inode) {
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
+  lock_acquire(&dir_lock);
   if (lookup(dir, name, &e, NULL))
     *inode = inode_open(e.inode_sector);
   else
     *inode = NULL;
+  lock_release(&dir_lock);
 
   return *inode != NULL;
 }
@@ -124,6 +135,8 @@ bool dir_add(struct dir* dir, const char* name, block_sector_t inode_sector) {
   if (*name == '\0' || strlen(name) > NAME_MAX)
     return false;
 
+  lock_acquire(&dir_lock);
+
   /* Check that NAME is not in use. */
   if (lookup(dir, name, NULL, NULL))
     goto done;
@@ -146,6 +159,7 @@ bool dir_add(struct dir* dir, const char* name, block_sector_t inode_sector) {
   success = inode_write_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
 
 done:
+  lock_release(&dir_lock);
   return success;
 }
 
@@ -161,6 +175,8 @@ bool dir_remove(struct dir* dir, const char* name) {
   ASSERT(dir != NULL);
   ASSERT(name != NULL);
 
+  lock_acquire(&dir_lock);
+
   /* Find directory entry. */
   if (!lookup(dir, name, &e, &ofs))
     goto done;
@@ -180,6 +196,7 @@ bool dir_remove(struct dir* dir, const char* name) {
   success = true;
 
 done:
+  lock_release(&dir_lock);
   inode_close(inode);
   return success;
 }
@@ -189,13 +206,17 @@ done:
    contains no more entries. */
 bool dir_readdir(struct dir* dir, char name[NAME_MAX + 1]) {
   struct dir_entry e;
+  bool found = false;
 
+  lock_acquire(&dir_lock);
   while (inode_read_at(dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
     dir->pos += sizeof e;
     if (e.in_use) {
       strlcpy(name, e.name, NAME_MAX + 1);
-      return true;
+      found = true;
+      break;
     }
   }
-  return false;
+  lock_release(&dir_lock);
+  return found;
 }
@@ -2,12 +2,15 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* An open file. */
 struct file {
   struct inode* inode; /* File's inode. */
   off_t pos;           /* Current position. */
   bool deny_write;     /* Has file_deny_write() been called? */
+  int ref_cnt;         /* References from file_open() and file_dup(). */
+  struct lock lock;    /* Protects pos and ref_cnt. */
 };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -19,6 +22,8 @@ struct file* file_open(struct inode* inode) {
     file->inode = inode;
     file->pos = 0;
     file->deny_write = false;
+    file->ref_cnt = 1;
+    lock_init(&file->lock);
     return file;
   } else {
     inode_close(inode);
@@ -33,9 +38,26 @@ struct file* file_reopen(struct file* file) {
   return file_open(inode_reopen(file->inode));
 }
 
-/* Closes FILE. */
+/* Adds a reference to FILE, sharing its position, and returns
+   FILE.  Each reference is dropped with file_close(). */
+struct file* file_dup(struct file* file) {
+  lock_acquire(&file->lock);
+  file->ref_cnt++;
+  lock_release(&file->lock);
+  return file;
+}
+
+/* Closes FILE, once its last reference is dropped. */
 void file_close(struct file* file) {
   if (file != NULL) {
+    bool last;
+
+    lock_acquire(&file->lock);
+    last = --file->ref_cnt == 0;
+    lock_release(&file->lock);
+    if (!last)
+      return;
+
     file_allow_write(file);
     inode_close(file->inode);
     free(file);
@@ -53,8 +75,12 @@ struct inode* file_get_inode(struct file* file) {
    which may be less than SIZE if end of file is reached.
    Advances FILE's position by the number of bytes read. */
 off_t file_read(struct file* file, void* buffer, off_t size) {
-  off_t bytes_read = inode_read_at(file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  lock_acquire(&file->lock);
+  bytes_read = inode_read_at(file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
+  lock_release(&file->lock);
   return bytes_read;
 }
 
@@ -75,8 +101,12 @@ off_t file_read_at(struct file* file, void* buffer, off_t size, off_t file_ofs)
    not yet implemented.)
    Advances FILE's position by the number of bytes read. */
 off_t file_write(struct file* file, const void* buffer, off_t size) {
-  off_t bytes_written = inode_write_at(file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  lock_acquire(&file->lock);
+  bytes_written = inode_write_at(file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
+  lock_release(&file->lock);
   return bytes_written;
 }
 
@@ -123,12 +153,19 @@ off_t file_length(struct file* file) {
 void file_seek(struct file* file, off_t new_pos) {
   ASSERT(file != NULL);
   ASSERT(new_pos >= 0);
+  lock_acquire(&file->lock);
   file->pos = new_pos;
+  lock_release(&file->lock);
 }
 
 /* Returns the current position in FILE as a byte offset from the
    start of the file. */
 off_t file_tell(struct file* file) {
+  off_t pos;
+
   ASSERT(file != NULL);
-  return file->pos;
+  lock_acquire(&file->lock);
+  pos = file->pos;
+  lock_release(&file->lock);
+  return pos;
 }
@@ -20,6 +20,7 @@ void filesys_init(bool format) {
     PANIC("No file system device found, can't initialize file system.");
 
   inode_init();
+  dir_init();
   free_map_init();
 
   if (format)
@@ -0,0 +1,293 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Red-black tree implementation, following the presentation in
+   [CLRS] chapter 13, with NULL standing in for the black leaf
+   sentinel.  A tree satisfies these invariants:
+
+     1. Every element is red or black.
+     2. The root is black.
+     3. A red element has no red children.
+     4. Every path from an element down to a NULL leaf passes
+        through the same number of black elements.
+
+   Together these bound the height by 2 lg (n + 1). */
+
+static void rotate_left(struct rb_tree*, struct rb_elem*);
+static void rotate_right(struct rb_tree*, struct rb_elem*);
+static void transplant(struct rb_tree*, struct rb_elem* u, struct rb_elem* v);
+static void insert_fixup(struct rb_tree*, struct rb_elem*);
+static void remove_fixup(struct rb_tree*, struct rb_elem* x, struct rb_elem* parent);
+static struct rb_elem* subtree_min(struct rb_elem*);
+static inline bool is_red(const struct rb_elem* e) { return e != NULL && e->red; }
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void rb_init(struct rb_tree* tree, rb_less_func* less, void* aux) {
+  ASSERT(tree != NULL);
+  ASSERT(less != NULL);
+
+  tree->root = NULL;
+  tree->leftmost = NULL;
+  tree->size = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts ELEM into TREE, after any elements equal to it. */
+void rb_insert(struct rb_tree* tree, struct rb_elem* elem) {
+  struct rb_elem* parent = NULL;
+  struct rb_elem** link = &tree->root;
+  bool leftmost = true;
+
+  ASSERT(tree != NULL);
+  ASSERT(elem != NULL);
+
+  while (*link != NULL) {
+    parent = *link;
+    if (tree->less(elem, parent, tree->aux))
+      link = &parent->left;
+    else {
+      link = &parent->right;
+      leftmost = false;
+    }
+  }
+
+  elem->parent = parent;
+  elem->left = elem->right = NULL;
+  elem->red = true;
+  *link = elem;
+
+  if (leftmost)
+    tree->leftmost = elem;
+  tree->size++;
+
+  insert_fixup(tree, elem);
+}
+
+/* Removes ELEM, which must be in TREE, from TREE. */
+void rb_remove(struct rb_tree* tree, struct rb_elem* elem) {
+  struct rb_elem* y = elem;
+  struct rb_elem* x;
+  struct rb_elem* x_parent;
+  bool removed_red = y->red;
+
+  ASSERT(tree != NULL);
+  ASSERT(elem != NULL);
+  ASSERT(tree->size > 0);
+
+  if (tree->leftmost == elem)
+    tree->leftmost = rb_next(elem);
+
+  if (elem->left == NULL) {
+    x = elem->right;
+    x_parent = elem->parent;
+    transplant(tree, elem, elem->right);
+  } else if (elem->right == NULL) {
+    x = elem->left;
+    x_parent = elem->parent;
+    transplant(tree, elem, elem->left);
+  } else {
+    /* Two children: splice out ELEM's successor Y, which has no
+       left child, and put it in ELEM's place. */
+    y = subtree_min(elem->right);
+    removed_red = y->red;
+    x = y->right;
+    if (y->parent == elem)
+      x_parent = y;
+    else {
+      x_parent = y->parent;
+      transplant(tree, y, y->right);
+      y->right = elem->right;
+      y->right->parent = y;
+    }
+    transplant(tree, elem, y);
+    y->left = elem->left;
+    y->left->parent = y;
+    y->red = elem->red;
+  }
+
+  if (!removed_red)
+    remove_fixup(tree, x, x_parent);
+  tree->size--;
+}
+
+/* Returns the minimum element of TREE, or NULL if TREE is
+   empty.  Runs in constant time. */
+struct rb_elem* rb_min(const struct rb_tree* tree) {
+  return tree->leftmost;
+}
+
+/* Returns the element that follows ELEM in its tree, or NULL if
+   ELEM is the maximum. */
+struct rb_elem* rb_next(struct rb_elem* elem) {
+  struct rb_elem* parent;
+
+  if (elem->right != NULL)
+    return subtree_min(elem->right);
+
+  parent = elem->parent;
+  while (parent != NULL && elem == parent->right) {
+    elem = parent;
+    parent = parent->parent;
+  }
+  return parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t rb_size(const struct rb_tree* tree) { return tree->size; }
+
+/* Returns true if TREE contains no elements, false otherwise. */
+bool rb_empty(const struct rb_tree* tree) { return tree->size == 0; }
+
+/* Returns the minimum element in the subtree rooted at ELEM. */
+static struct rb_elem* subtree_min(struct rb_elem* elem) {
+  while (elem->left != NULL)
+    elem = elem->left;
+  return elem;
+}
+
+/* Makes X's right child take X's place, with X as its left
+   child. */
+static void rotate_left(struct rb_tree* tree, struct rb_elem* x) {
+  struct rb_elem* y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  transplant(tree, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/* Makes X's left child take X's place, with X as its right
+   child. */
+static void rotate_right(struct rb_tree* tree, struct rb_elem* x) {
+  struct rb_elem* y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  transplant(tree, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/* Replaces the subtree rooted at U by the one rooted at V, which
+   may be NULL.  U's own child pointers are left alone. */
+static void transplant(struct rb_tree* tree, struct rb_elem* u, struct rb_elem* v) {
+  if (u->parent == NULL)
+    tree->root = v;
+  else if (u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+  if (v != NULL)
+    v->parent = u->parent;
+}
+
+/* Restores the red-black invariants after inserting red ELEM. */
+static void insert_fixup(struct rb_tree* tree, struct rb_elem* elem) {
+  struct rb_elem* parent;
+
+  while ((parent = elem->parent) != NULL && parent->red) {
+    /* PARENT is red, so it is not the root and has a parent. */
+    struct rb_elem* grandparent = parent->parent;
+
+    if (parent == grandparent->left) {
+      struct rb_elem* uncle = grandparent->right;
+      if (is_red(uncle)) {
+        parent->red = uncle->red = false;
+        grandparent->red = true;
+        elem = grandparent;
+      } else {
+        if (elem == parent->right) {
+          rotate_left(tree, parent);
+          elem = parent;
+          parent = elem->parent;
+        }
+        parent->red = false;
+        grandparent->red = true;
+        rotate_right(tree, grandparent);
+      }
+    } else {
+      struct rb_elem* uncle = grandparent->left;
+      if (is_red(uncle)) {
+        parent->red = uncle->red = false;
+        grandparent->red = true;
+        elem = grandparent;
+      } else {
+        if (elem == parent->left) {
+          rotate_right(tree, parent);
+          elem = parent;
+          parent = elem->parent;
+        }
+        parent->red = false;
+        grandparent->red = true;
+        rotate_left(tree, grandparent);
+      }
+    }
+  }
+  tree->root->red = false;
+}
+
+/* Restores the red-black invariants after a black element was
+   removed from above X, whose parent is now PARENT.  X carries
+   an extra black and may be NULL. */
+static void remove_fixup(struct rb_tree* tree, struct rb_elem* x, struct rb_elem* parent) {
+  while (x != tree->root && !is_red(x)) {
+    if (x == parent->left) {
+      struct rb_elem* sibling = parent->right;
+      if (sibling->red) {
+        sibling->red = false;
+        parent->red = true;
+        rotate_left(tree, parent);
+        sibling = parent->right;
+      }
+      if (!is_red(sibling->left) && !is_red(sibling->right)) {
+        sibling->red = true;
+        x = parent;
+        parent = x->parent;
+      } else {
+        if (!is_red(sibling->right)) {
+          sibling->left->red = false;
+          sibling->red = true;
+          rotate_right(tree, sibling);
+          sibling = parent->right;
+        }
+        sibling->red = parent->red;
+        parent->red = false;
+        sibling->right->red = false;
+        rotate_left(tree, parent);
+        x = tree->root;
+      }
+    } else {
+      struct rb_elem* sibling = parent->left;
+      if (sibling->red) {
+        sibling->red = false;
+        parent->red = true;
+        rotate_right(tree, parent);
+        sibling = parent->left;
+      }
+      if (!is_red(sibling->left) && !is_red(sibling->right)) {
+        sibling->red = true;
+        x = parent;
+        parent = x->parent;
+      } else {
+        if (!is_red(sibling->left)) {
+          sibling->right->red = false;
+          sibling->red = true;
+          rotate_left(tree, sibling);
+          sibling = parent->left;
+        }
+        sibling->red = parent->red;
+        parent->red = false;
+        sibling->left->red = false;
+        rotate_right(tree, parent);
+        x = tree->root;
+      }
+    }
+  }
+  if (x != NULL)
+    x->red = false;
+}
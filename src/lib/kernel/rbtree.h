@@ -0,0 +1,65 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A balanced binary search tree with O(log n) insertion and
+   removal.  Like the list and hash table implementations, it
+   does not allocate memory: each structure that can be an
+   element of a tree must embed a struct rb_elem member, and the
+   rb_entry macro converts a struct rb_elem back into the
+   structure that contains it.
+
+   Elements are ordered by a caller-supplied rb_less_func.
+   Elements that compare equal are allowed; a new element is
+   placed after all the elements equal to it, so equal keys come
+   out in insertion order.
+
+   The leftmost (minimum) element is cached, so rb_min() is O(1).
+   That makes the tree usable as a priority queue that also
+   supports removing arbitrary elements. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem {
+  struct rb_elem* parent; /* Parent, or NULL at the root. */
+  struct rb_elem* left;   /* Left child, or NULL. */
+  struct rb_elem* right;  /* Right child, or NULL. */
+  bool red;               /* Node color. */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to
+   the structure that RB_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                                                          \
+  ((STRUCT*)((uint8_t*)&(RB_ELEM)->parent - offsetof(STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func(const struct rb_elem* a, const struct rb_elem* b, void* aux);
+
+/* Red-black tree. */
+struct rb_tree {
+  struct rb_elem* root;     /* Root, or NULL if empty. */
+  struct rb_elem* leftmost; /* Minimum element, or NULL if empty. */
+  size_t size;              /* Number of elements. */
+  rb_less_func* less;       /* Comparison function. */
+  void* aux;                /* Auxiliary data for `less'. */
+};
+
+void rb_init(struct rb_tree*, rb_less_func*, void* aux);
+void rb_insert(struct rb_tree*, struct rb_elem*);
+void rb_remove(struct rb_tree*, struct rb_elem*);
+
+struct rb_elem* rb_min(const struct rb_tree*);
+struct rb_elem* rb_next(struct rb_elem*);
+
+size_t rb_size(const struct rb_tree*);
+bool rb_empty(const struct rb_tree*);
+
+#endif /* lib/kernel/rbtree.h */
@@ -0,0 +1,24 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/* Which threads getrusage() reports on. */
+#define RUSAGE_SELF 0   /* Every thread of the calling process, live or exited. */
+#define RUSAGE_THREAD 1 /* The calling thread only. */
+
+/* Resource usage, as reported by the getrusage() system call.
+   Times are measured with the CPU's time-stamp counter and are
+   also given in cycles. */
+struct rusage {
+  int64_t utime_ns;          /* Time spent running in user mode. */
+  int64_t stime_ns;          /* Time spent running in the kernel. */
+  int64_t lock_wait_ns;      /* Time spent waiting to acquire kernel locks. */
+  uint64_t utime_cycles;     /* utime_ns, in TSC cycles. */
+  uint64_t stime_cycles;     /* stime_ns, in TSC cycles. */
+  uint64_t lock_wait_cycles; /* lock_wait_ns, in TSC cycles. */
+  int64_t nvcsw;             /* Voluntary context switches (blocking). */
+  int64_t nivcsw;            /* Involuntary context switches (preemption, yield). */
+};
+
+#endif /* lib/rusage.h */
@@ -0,0 +1,12 @@
+#ifndef __LIB_STACK_SLOT_H
+#define __LIB_STACK_SLOT_H
+
+/* Each non-main thread's user stack is a slot of STACK_SLOT_PAGES
+   4 kB pages, the lowest of which is an unmapped guard page.
+   Slots are aligned to their size, so user code can tell which
+   thread it is from its stack pointer alone; see pthread_self().
+   The kernel lays the slots out in userprog/process.c. */
+#define STACK_SLOT_PAGES 16
+#define STACK_SLOT_SIZE (STACK_SLOT_PAGES * 4096u)
+
+#endif /* lib/stack-slot.h */
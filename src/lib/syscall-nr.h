@@ -22,13 +22,13 @@ enum {
   SYS_PT_CREATE,    /* Creates a new thread */
   SYS_PT_EXIT,      /* Exits the current thread */
   SYS_PT_JOIN,      /* Waits for thread to finish */
-  SYS_LOCK_INIT,    /* Initializes a lock */
-  SYS_LOCK_ACQUIRE, /* Acquires a lock */
-  SYS_LOCK_RELEASE, /* Releases a lock */
-  SYS_SEMA_INIT,    /* Initializes a semaphore */
-  SYS_SEMA_DOWN,    /* Downs a semaphore */
-  SYS_SEMA_UP,      /* Ups a semaphore */
+  SYS_PT_CREATE_MANY, /* Creates several threads at once */
+  SYS_PT_JOIN_ALL,  /* Waits for several threads to finish */
+  SYS_FUTEX_WAIT,   /* Sleeps on a user lock or semaphore word */
+  SYS_FUTEX_WAKE,   /* Wakes threads sleeping on a word */
   SYS_GET_TID,      /* Gets TID of the current thread */
+  SYS_GETRUSAGE,    /* Reports CPU usage */
+  SYS_SET_THREAD_AREA, /* Sets the base of the thread's GS segment */
 
   /* Project 3 and optionally project 4. */
   SYS_MMAP,   /* Map a file into memory. */
@@ -1,6 +1,13 @@
 #include <syscall.h>
+#include <tls.h>
 
 int main(int, char* []);
 void _start(int argc, char* argv[]);
 
-void _start(int argc, char* argv[]) { exit(main(argc, argv)); }
+void _start(int argc, char* argv[]) {
+  struct tls_block tls;
+
+  syscall_sysenter = sysenter_available();
+  tls_init(&tls);
+  exit(main(argc, argv));
+}
@@ -1,5 +1,7 @@
 #include <pthread.h>
+#include <stack-slot.h>
 #include <syscall.h>
+#include <tls.h>
 
 void _pthread_start_stub(pthread_fun fun, void* arg);
 
@@ -20,10 +22,35 @@ void pthread_exit() {
    Returns false if an error occurred. */
 bool pthread_join(tid_t tid) { return sys_pthread_join(tid) != TID_ERROR; }
 
+/* Creates N threads in a single system call, the Ith running fun
+   with ARGS[I], and stores their TIDs in TIDS.  Stops at the first
+   thread that cannot be created.
+   Returns the number of threads created. */
+int pthread_create_many(pthread_fun fun, void* const args[], int n, tid_t tids[]) {
+  return sys_pthread_create_many(_pthread_start_stub, fun, args, n, tids);
+}
+
+/* Waits for each of the N threads in TIDS in a single system call.
+   Returns false if any of them could not be joined. */
+bool pthread_join_all(const tid_t tids[], int n) { return sys_pthread_join_all(tids, n) == n; }
+
+/* Returns a nonzero value that identifies the calling thread
+   among the live threads of this process: the aligned slot
+   holding its user stack.  Every thread's stack is in a separate
+   slot, so this needs no system call. */
+unsigned pthread_self(void) {
+  unsigned esp;
+  asm("movl %%esp, %0" : "=g"(esp));
+  return esp & ~(STACK_SLOT_SIZE - 1);
+}
+
 /* OS jumps to this function when a new thread is created.
    OS is required to setup the stack for this function and
    set %eip to point to the start of this function */
 void _pthread_start_stub(pthread_fun fun, void* arg) {
+  struct tls_block tls;
+
+  tls_init(&tls); // Set up thread-local storage
   (*fun)(arg);    // Invoke the thread function
   pthread_exit(); // Call pthread_exit
 }
@@ -13,5 +13,8 @@ typedef int tid_t;
 tid_t pthread_create(pthread_fun fun, void* arg);
 void pthread_exit(void) NO_RETURN;
 bool pthread_join(tid_t);
+unsigned pthread_self(void);
+int pthread_create_many(pthread_fun fun, void* const args[], int n, tid_t tids[]);
+bool pthread_join_all(const tid_t tids[], int n);
 
 #endif /* lib/user/pthread.h */
@@ -1,16 +1,32 @@
 #include <syscall.h>
 #include "../syscall-nr.h"
 #include <pthread.h>
+#include <stddef.h>
+
+/* Enter the kernel by SYSENTER rather than int $0x30?  Set by
+   _start() if the kernel supports it. */
+bool syscall_sysenter;
+
+/* Enters the kernel for the system call whose number and
+   arguments are on top of the stack, by SYSENTER if
+   syscall_sysenter is set or else by int $0x30.  SYSENTER
+   returns to the address in EDX with the stack pointer in ECX,
+   so it clobbers both.  Needs a `fast' operand naming
+   syscall_sysenter. */
+#define SYSCALL_ENTER                                                                              \
+  "cmpb $0, %[fast]; je 2f; "                                                                      \
+  "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "                                                 \
+  "2: int $0x30; 1: "
 
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                                                           \
   ({                                                                                               \
     int retval;                                                                                    \
-    asm volatile("pushl %[number]; int $0x30; addl $4, %%esp"                                      \
+    asm volatile("pushl %[number]; " SYSCALL_ENTER "addl $4, %%esp"                                \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER)                                                            \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter)                              \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -19,10 +35,10 @@
 #define syscall1(NUMBER, ARG0)                                                                     \
   ({                                                                                               \
     int retval;                                                                                    \
-    asm volatile("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp"                       \
+    asm volatile("pushl %[arg0]; pushl %[number]; " SYSCALL_ENTER "addl $8, %%esp"                 \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "g"(ARG0)                                          \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter), [arg0] "g"(ARG0)            \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -31,10 +47,10 @@
 #define syscall1f(NUMBER, ARG0)                                                                    \
   ({                                                                                               \
     float retval;                                                                                  \
-    asm volatile("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp"                       \
+    asm volatile("pushl %[arg0]; pushl %[number]; " SYSCALL_ENTER "addl $8, %%esp"                 \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "g"(ARG0)                                          \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter), [arg0] "g"(ARG0)            \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -44,10 +60,11 @@
   ({                                                                                               \
     int retval;                                                                                    \
     asm volatile("pushl %[arg1]; pushl %[arg0]; "                                                  \
-                 "pushl %[number]; int $0x30; addl $12, %%esp"                                     \
+                 "pushl %[number]; " SYSCALL_ENTER "addl $12, %%esp"                               \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "r"(ARG0), [arg1] "r"(ARG1)                        \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter),                             \
+                   [arg0] "r"(ARG0), [arg1] "r"(ARG1)                                              \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -57,10 +74,26 @@
   ({                                                                                               \
     int retval;                                                                                    \
     asm volatile("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "                                   \
-                 "pushl %[number]; int $0x30; addl $16, %%esp"                                     \
+                 "pushl %[number]; " SYSCALL_ENTER "addl $16, %%esp"                               \
                  : "=a"(retval)                                                                    \
-                 : [number] "i"(NUMBER), [arg0] "r"(ARG0), [arg1] "r"(ARG1), [arg2] "r"(ARG2)      \
-                 : "memory");                                                                      \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter),                             \
+                   [arg0] "r"(ARG0), [arg1] "r"(ARG1), [arg2] "r"(ARG2)                            \
+                 : "ecx", "edx", "memory");                                                        \
+    retval;                                                                                        \
+  })
+
+/* Invokes syscall NUMBER, passing arguments ARG0 through ARG4,
+   and returns the return value as an `int'. */
+#define syscall5(NUMBER, ARG0, ARG1, ARG2, ARG3, ARG4)                                             \
+  ({                                                                                               \
+    int retval;                                                                                    \
+    asm volatile("pushl %[arg4]; pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "     \
+                 "pushl %[number]; " SYSCALL_ENTER "addl $24, %%esp"                               \
+                 : "=a"(retval)                                                                    \
+                 : [number] "i"(NUMBER), [fast] "m"(syscall_sysenter),                             \
+                   [arg0] "r"(ARG0), [arg1] "r"(ARG1), [arg2] "r"(ARG2),                           \
+                   [arg3] "r"(ARG3), [arg4] "g"(ARG4)                                              \
+                 : "ecx", "edx", "memory");                                                        \
     retval;                                                                                        \
   })
 
@@ -129,32 +162,108 @@ void sys_pthread_exit() {
 
 tid_t sys_pthread_join(tid_t tid) { return syscall1(SYS_PT_JOIN, tid); }
 
-bool lock_init(lock_t* lock) { return syscall1(SYS_LOCK_INIT, lock); }
+int sys_pthread_create_many(stub_fun sfun, pthread_fun tfun, void* const args[], int n,
+                            tid_t tids[]) {
+  return syscall5(SYS_PT_CREATE_MANY, sfun, tfun, args, n, tids);
+}
+
+int sys_pthread_join_all(const tid_t tids[], int n) {
+  return syscall2(SYS_PT_JOIN_ALL, tids, n);
+}
+
+/* Marks initialized locks and semaphores, so that using one that
+   was never initialized fails instead of misbehaving. */
+#define LOCK_MAGIC 0x4c4f434b
+#define SEMA_MAGIC 0x53454d41
+
+bool futex_wait(int* addr, int val) { return syscall2(SYS_FUTEX_WAIT, addr, val); }
 
+int futex_wake(int* addr, int cnt) { return syscall2(SYS_FUTEX_WAKE, addr, cnt); }
+
+bool lock_init(lock_t* lock) {
+  if (lock == NULL)
+    return false;
+  lock->state = 0;
+  lock->owner = 0;
+  lock->magic = LOCK_MAGIC;
+  return true;
+}
+
+/* Acquires LOCK.  The state goes 0 -> 1 with no contention; a
+   thread that finds it held marks it 2 and sleeps, so that the
+   release knows someone must be woken. */
 void lock_acquire(lock_t* lock) {
-  bool success = syscall1(SYS_LOCK_ACQUIRE, lock);
-  if (!success)
+  unsigned self = pthread_self();
+  int c;
+
+  if (lock->magic != LOCK_MAGIC || lock->owner == self)
     exit(1);
+
+  c = __sync_val_compare_and_swap(&lock->state, 0, 1);
+  if (c != 0) {
+    if (c != 2)
+      c = __sync_lock_test_and_set(&lock->state, 2);
+    while (c != 0) {
+      futex_wait(&lock->state, 2);
+      c = __sync_lock_test_and_set(&lock->state, 2);
+    }
+  }
+  lock->owner = self;
 }
 
+/* Releases LOCK, entering the kernel only if a thread may be
+   sleeping on it. */
 void lock_release(lock_t* lock) {
-  bool success = syscall1(SYS_LOCK_RELEASE, lock);
-  if (!success)
+  if (lock->magic != LOCK_MAGIC || lock->owner != pthread_self())
     exit(1);
+
+  lock->owner = 0;
+  if (__sync_fetch_and_sub(&lock->state, 1) != 1) {
+    lock->state = 0;
+    futex_wake(&lock->state, 1);
+  }
 }
 
-bool sema_init(sema_t* sema, int val) { return syscall2(SYS_SEMA_INIT, sema, val); }
+bool sema_init(sema_t* sema, int val) {
+  if (sema == NULL || val < 0)
+    return false;
+  sema->value = val;
+  sema->sleepers = 0;
+  sema->magic = SEMA_MAGIC;
+  return true;
+}
 
+/* Waits for SEMA's value to become positive and decrements it.
+   The kernel rechecks that the value is still 0 before putting
+   us to sleep, so a sema_up() between our check and the sleep is
+   not lost. */
 void sema_down(sema_t* sema) {
-  bool success = syscall1(SYS_SEMA_DOWN, sema);
-  if (!success)
+  if (sema->magic != SEMA_MAGIC)
     exit(1);
+
+  for (;;) {
+    int v = sema->value;
+    if (v > 0) {
+      if (__sync_bool_compare_and_swap(&sema->value, v, v - 1))
+        return;
+    } else {
+      __sync_fetch_and_add(&sema->sleepers, 1);
+      futex_wait(&sema->value, 0);
+      __sync_fetch_and_sub(&sema->sleepers, 1);
+    }
+  }
 }
 
+/* Increments SEMA's value, waking one sleeper if there is any. */
 void sema_up(sema_t* sema) {
-  bool success = syscall1(SYS_SEMA_UP, sema);
-  if (!success)
+  if (sema->magic != SEMA_MAGIC)
     exit(1);
+
+  __sync_fetch_and_add(&sema->value, 1);
+  if (sema->sleepers > 0)
+    futex_wake(&sema->value, 1);
 }
 
-tid_t get_tid(void) { return syscall0(SYS_GET_TID); }
+int getrusage(int who, struct rusage* usage) { return syscall2(SYS_GETRUSAGE, who, usage); }
+
+int set_thread_area(void* base) { return syscall1(SYS_SET_THREAD_AREA, base); }
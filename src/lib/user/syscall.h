@@ -2,21 +2,44 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
 #include <pthread.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t)-1)
 
-/* Synchronization Types */
-typedef char lock_t;
-typedef char sema_t;
+/* Synchronization Types.  Locks and semaphores live entirely in
+   user memory and are updated with atomic instructions, so the
+   uncontended paths never enter the kernel.  A thread that must
+   wait sleeps with futex_wait() and is woken with futex_wake(). */
+typedef struct {
+  int state;      /* 0 if free, 1 if held, 2 if held with sleepers. */
+  unsigned magic; /* LOCK_MAGIC once initialized. */
+  unsigned owner; /* Stack slot of the holding thread, or 0. */
+} lock_t;
+
+typedef struct {
+  int value;      /* Current value. */
+  unsigned magic; /* SEMA_MAGIC once initialized. */
+  int sleepers;   /* Threads sleeping in sema_down(). */
+} sema_t;
 
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t)-1)
 
+/* A time, as reported by clock_gettime(). */
+struct timespec {
+  int64_t tv_sec; /* Seconds. */
+  long tv_nsec;   /* Nanoseconds, less than 1,000,000,000. */
+};
+
+/* Clocks for clock_gettime(). */
+#define CLOCK_MONOTONIC 1 /* Time since the OS booted. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -24,6 +47,10 @@ typedef int mapid_t;
 #define EXIT_SUCCESS 0 /* Successful execution. */
 #define EXIT_FAILURE 1 /* Unsuccessful execution. */
 
+/* True to make system calls with SYSENTER, false to use
+   int $0x30.  Initially true if sysenter_available(). */
+extern bool syscall_sysenter;
+
 /* Projects 2 and later. */
 void halt(void) NO_RETURN;
 void exit(int status) NO_RETURN;
@@ -43,13 +70,32 @@ double compute_e(int n);
 tid_t sys_pthread_create(stub_fun sfun, pthread_fun tfun, const void* arg);
 void sys_pthread_exit(void) NO_RETURN;
 tid_t sys_pthread_join(tid_t tid);
+int sys_pthread_create_many(stub_fun sfun, pthread_fun tfun, void* const args[], int n, tid_t tids[]);
+int sys_pthread_join_all(const tid_t tids[], int n);
 bool lock_init(lock_t* lock);
 void lock_acquire(lock_t* lock);
 void lock_release(lock_t* lock);
 bool sema_init(sema_t* sema, int val);
 void sema_down(sema_t* sema);
 void sema_up(sema_t* sema);
+bool futex_wait(int* addr, int val);
+int futex_wake(int* addr, int cnt);
+int getrusage(int who, struct rusage* usage);
+int set_thread_area(void* base);
+
+/* Read from the vDSO page, without system calls. */
+bool sysenter_available(void);
 tid_t get_tid(void);
+int64_t timer_ticks(void);
+int clock_gettime(int clock, struct timespec* ts);
+
+/* Returns the time-stamp counter, for timing code in CPU
+   cycles. */
+static inline uint64_t rdtsc(void) {
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap(int fd, void* addr);
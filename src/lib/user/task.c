@@ -0,0 +1,350 @@
+#include <task.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <tls.h>
+
+/* Reads or writes X exactly once, for data shared between
+   threads without a lock. */
+#define ACCESS_ONCE(X) (*(volatile __typeof__(X)*)&(X))
+
+/* Tasks a deque can hold; a power of two.  task_spawn() runs a
+   task on the spot when its worker's deque is full. */
+#define DEQUE_SIZE 256
+#define DEQUE_MASK (DEQUE_SIZE - 1)
+
+/* Set in task_group's `pending' once task_sync() may sleep on it,
+   so that the task that brings the count to zero wakes it. */
+#define GROUP_WAITING (1 << 30)
+
+/* A Chase-Lev deque [Chase and Lev, "Dynamic Circular
+   Work-Stealing Deque", SPAA 2005], with a fixed array because
+   we cannot allocate.  The owner pushes and pops at BOTTOM and
+   thieves take from TOP.  Both only ever increase, except that
+   the owner briefly lowers BOTTOM to claim a task, and BOTTOM -
+   TOP is the number of tasks. */
+struct deque {
+  int top;
+  int bottom;
+  struct task* tasks[DEQUE_SIZE];
+};
+
+/* A worker thread. */
+struct worker {
+  struct deque deque; /* Tasks spawned by this worker. */
+  tid_t tid;          /* Its thread, or TID_ERROR for worker 0. */
+  int next_victim;    /* Worker to try stealing from first. */
+
+  /* Statistics. */
+  unsigned executed; /* Tasks run. */
+  unsigned stolen;   /* Tasks stolen from other workers. */
+  unsigned inlined;  /* Tasks run inside task_spawn() because the deque was full. */
+};
+
+static struct worker workers[TASK_WORKERS_MAX];
+static int worker_cnt;
+
+/* Each worker thread's thread-local pointer to its worker, NULL
+   in threads outside the pool.  -1 until the first pool starts. */
+static tls_key_t worker_key = -1;
+
+/* Workers with nothing to do sleep on EPOCH, which task_spawn()
+   bumps when IDLE_CNT says a worker may be asleep. */
+static int epoch;
+static int idle_cnt;
+static bool stopping;
+
+static void worker_main(void* worker_);
+
+/* Pushes TASK onto the bottom of D.  Only D's owner may call
+   this.  Returns false if D is full. */
+static bool deque_push(struct deque* d, struct task* task) {
+  int b = d->bottom;
+
+  if (b - ACCESS_ONCE(d->top) >= DEQUE_SIZE)
+    return false;
+  d->tasks[b & DEQUE_MASK] = task;
+
+  /* x86 keeps stores in order, so a thief that sees the new
+     BOTTOM also sees the task; only the compiler needs fencing. */
+  asm volatile("" : : : "memory");
+  ACCESS_ONCE(d->bottom) = b + 1;
+  return true;
+}
+
+/* Pops the newest task off the bottom of D, or returns NULL if
+   D is empty.  Only D's owner may call this. */
+static struct task* deque_pop(struct deque* d) {
+  int b = d->bottom - 1;
+  struct task* task;
+  int t;
+
+  /* Claim slot B before looking at TOP.  A load may pass an
+     earlier store on x86, so this takes a full fence. */
+  ACCESS_ONCE(d->bottom) = b;
+  __sync_synchronize();
+  t = ACCESS_ONCE(d->top);
+
+  if (t > b) {
+    d->bottom = b + 1;
+    return NULL;
+  }
+  task = d->tasks[b & DEQUE_MASK];
+  if (t == b) {
+    /* The last task: a thief may be after it too, and whoever
+       advances TOP gets it. */
+    if (!__sync_bool_compare_and_swap(&d->top, t, t + 1))
+      task = NULL;
+    ACCESS_ONCE(d->bottom) = b + 1;
+  }
+  return task;
+}
+
+/* Steals the oldest task from the top of D.  Returns NULL if D
+   is empty or another thread took the task first. */
+static struct task* deque_steal(struct deque* d) {
+  int t = ACCESS_ONCE(d->top);
+  struct task* task;
+  int b;
+
+  __sync_synchronize();
+  b = ACCESS_ONCE(d->bottom);
+  if (t >= b)
+    return NULL;
+
+  task = ACCESS_ONCE(d->tasks[t & DEQUE_MASK]);
+  if (!__sync_bool_compare_and_swap(&d->top, t, t + 1))
+    return NULL;
+  return task;
+}
+
+/* Returns the calling thread's worker, or NULL if it is not a
+   worker of the running pool. */
+static struct worker* current_worker(void) {
+  return worker_key >= 0 ? tls_get(worker_key) : NULL;
+}
+
+/* Finds a task for W to run: the newest one in its own deque,
+   or else the oldest one in some other worker's.  W may be NULL
+   for a thread outside the pool, which can only steal. */
+static struct task* find_task(struct worker* w) {
+  int cnt = ACCESS_ONCE(worker_cnt);
+  struct task* task;
+  int start;
+
+  if (w != NULL) {
+    task = deque_pop(&w->deque);
+    if (task != NULL)
+      return task;
+    start = w->next_victim;
+  } else
+    start = 0;
+
+  for (int i = 0; i < cnt; i++) {
+    struct worker* victim = &workers[(start + i) % cnt];
+    if (victim == w)
+      continue;
+    task = deque_steal(&victim->deque);
+    if (task != NULL) {
+      if (w != NULL) {
+        w->stolen++;
+        w->next_victim = victim - workers;
+      }
+      return task;
+    }
+  }
+  return NULL;
+}
+
+/* Runs TASK on W, which may be NULL, and reports its completion
+   to its group.  The group may vanish as soon as its count
+   reaches zero, so it is not touched after that except for the
+   wakeup, which is harmless if spurious. */
+static void run_task(struct worker* w, struct task* task) {
+  struct task_group* g = task->group;
+
+  task->fun(task->arg);
+  if (w != NULL)
+    w->executed++;
+  if (__sync_sub_and_fetch(&g->pending, 1) == GROUP_WAITING)
+    futex_wake(&g->pending, 1);
+}
+
+/* Starts a pool of N workers: the calling thread, which becomes
+   worker 0, plus N - 1 new threads.  If fewer threads can be
+   created, runs with as many as were.  Returns false if N is out
+   of range, a pool is already running, or there is no TLS key
+   left to find workers by. */
+bool task_runtime_init(int n) {
+  void* args[TASK_WORKERS_MAX];
+  tid_t tids[TASK_WORKERS_MAX];
+  int created;
+
+  if (n < 1 || n > TASK_WORKERS_MAX || worker_cnt != 0)
+    return false;
+  if (worker_key < 0 && (worker_key = tls_key_create()) < 0)
+    return false;
+
+  for (int i = 0; i < n; i++) {
+    struct worker* w = &workers[i];
+    w->deque.top = w->deque.bottom = 0;
+    w->tid = TID_ERROR;
+    w->next_victim = (i + 1) % n;
+    w->executed = w->stolen = w->inlined = 0;
+    args[i] = w;
+  }
+  tls_set(worker_key, &workers[0]);
+  stopping = false;
+  epoch = idle_cnt = 0;
+
+  /* New workers may start stealing before WORKER_CNT counts them,
+     which only means they ignore each other for a moment. */
+  worker_cnt = 1;
+  created = pthread_create_many(worker_main, args + 1, n - 1, tids);
+  for (int i = 0; i < created; i++)
+    workers[i + 1].tid = tids[i];
+  ACCESS_ONCE(worker_cnt) = created + 1;
+  return true;
+}
+
+/* Stops the pool's worker threads and waits for them to exit.
+   Must be called by worker 0 once all tasks are finished. */
+void task_runtime_shutdown(void) {
+  tid_t tids[TASK_WORKERS_MAX];
+
+  ACCESS_ONCE(stopping) = true;
+  __sync_fetch_and_add(&epoch, 1);
+  futex_wake(&epoch, TASK_WORKERS_MAX);
+
+  for (int i = 1; i < worker_cnt; i++)
+    tids[i - 1] = workers[i].tid;
+  pthread_join_all(tids, worker_cnt - 1);
+  worker_cnt = 0;
+  tls_set(worker_key, NULL);
+}
+
+/* Prints each worker's task counts, to show how evenly the work
+   was spread. */
+void task_runtime_print_stats(void) {
+  for (int i = 0; i < worker_cnt; i++)
+    printf("worker %d: %u tasks run, %u stolen, %u run inline\n", i, workers[i].executed,
+           workers[i].stolen, workers[i].inlined);
+}
+
+/* Initializes G as a group with no tasks. */
+void task_group_init(struct task_group* g) { g->pending = 0; }
+
+/* Arranges for FUN(ARG) to run as a task in group G, using TASK,
+   which must stay valid until task_sync(G) returns.  The task
+   may run on any worker, or right away on this thread if it is
+   not a worker or its deque is full. */
+void task_spawn(struct task_group* g, struct task* task, task_fun* fun, void* arg) {
+  struct worker* w = current_worker();
+
+  task->fun = fun;
+  task->arg = arg;
+  task->group = g;
+  __sync_fetch_and_add(&g->pending, 1);
+
+  if (w == NULL || !deque_push(&w->deque, task)) {
+    if (w != NULL)
+      w->inlined++;
+    run_task(w, task);
+    return;
+  }
+
+  /* Pairs with the fence in worker_main() between counting
+     itself idle and its last look for work: either it finds this
+     task or we see it is idle and wake it. */
+  __sync_synchronize();
+  if (ACCESS_ONCE(idle_cnt) > 0) {
+    __sync_fetch_and_add(&epoch, 1);
+    futex_wake(&epoch, 1);
+  }
+}
+
+/* Waits until every task spawned in G has finished, running
+   other tasks in the meantime. */
+void task_sync(struct task_group* g) {
+  struct worker* w = current_worker();
+
+  for (;;) {
+    int pending = ACCESS_ONCE(g->pending);
+    struct task* task;
+
+    if ((pending & ~GROUP_WAITING) == 0)
+      return;
+
+    task = find_task(w);
+    if (task != NULL)
+      run_task(w, task);
+    else if (!(pending & GROUP_WAITING))
+      __sync_fetch_and_or(&g->pending, GROUP_WAITING);
+    else
+      futex_wait(&g->pending, pending);
+  }
+}
+
+/* Arguments for parallel_for_range(). */
+struct parallel_for_args {
+  int lo, hi;             /* Indices [LO, HI) to cover. */
+  int grain;              /* Largest range to run without splitting. */
+  parallel_for_fun* body; /* Loop body. */
+  void* aux;              /* Its auxiliary data. */
+};
+
+/* Task function for parallel_for(): splits its range in half
+   until it is no bigger than the grain, spawning the upper half
+   each time so that thieves take the biggest pieces. */
+static void parallel_for_range(void* args_) {
+  struct parallel_for_args* args = args_;
+  struct parallel_for_args lower, upper;
+  struct task_group g;
+  struct task task;
+
+  if (args->hi - args->lo <= args->grain) {
+    args->body(args->lo, args->hi, args->aux);
+    return;
+  }
+
+  lower = upper = *args;
+  lower.hi = upper.lo = args->lo + (args->hi - args->lo) / 2;
+
+  task_group_init(&g);
+  task_spawn(&g, &task, parallel_for_range, &upper);
+  parallel_for_range(&lower);
+  task_sync(&g);
+}
+
+/* Calls BODY(lo, hi, AUX) over subranges that together cover
+   [BEGIN, END) exactly once, in parallel across the pool's
+   workers.  No subrange is longer than GRAIN indices.  Returns
+   once all of them are done. */
+void parallel_for(int begin, int end, int grain, parallel_for_fun* body, void* aux) {
+  struct parallel_for_args args = {begin, end, grain > 0 ? grain : 1, body, aux};
+
+  if (begin < end)
+    parallel_for_range(&args);
+}
+
+/* Thread function for workers other than worker 0: runs tasks
+   until the pool is shut down, sleeping when there are none. */
+static void worker_main(void* worker_) {
+  struct worker* w = worker_;
+
+  tls_set(worker_key, w);
+  while (!ACCESS_ONCE(stopping)) {
+    int seen = ACCESS_ONCE(epoch);
+    struct task* task = find_task(w);
+
+    if (task == NULL) {
+      __sync_fetch_and_add(&idle_cnt, 1);
+      task = find_task(w);
+      if (task == NULL && !ACCESS_ONCE(stopping))
+        futex_wait(&epoch, seen);
+      __sync_fetch_and_sub(&idle_cnt, 1);
+    }
+    if (task != NULL)
+      run_task(w, task);
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef __LIB_USER_TASK_H
+#define __LIB_USER_TASK_H
+
+#include <stdbool.h>
+
+/* Work-stealing task runtime.
+
+   task_runtime_init() starts a fixed pool of worker threads; the
+   calling thread becomes worker 0.  Each worker owns a deque of
+   tasks.  task_spawn() pushes a task onto the bottom of the
+   calling worker's deque, and the worker pops its own tasks from
+   the bottom, newest first.  A worker that runs out of tasks
+   steals the oldest task from the top of another worker's deque,
+   so big chunks of work migrate to idle workers while each
+   worker keeps the cache-warm work it created itself.
+
+   There is no user-level malloc, so the runtime never allocates:
+   a task and its group live in the spawning function's frame,
+   which must not return before task_sync() on the group. */
+
+/* A function run as a task. */
+typedef void task_fun(void* arg);
+
+/* A set of spawned tasks that task_sync() waits for. */
+struct task_group {
+  int pending; /* Unfinished tasks, plus a flag for a sleeping task_sync(). */
+};
+
+/* A spawned task. */
+struct task {
+  task_fun* fun;            /* Function to run. */
+  void* arg;                /* Its argument. */
+  struct task_group* group; /* Group to notify on completion. */
+};
+
+/* Maximum number of workers, including the initial thread. */
+#define TASK_WORKERS_MAX 8
+
+bool task_runtime_init(int n);
+void task_runtime_shutdown(void);
+void task_runtime_print_stats(void);
+
+void task_group_init(struct task_group*);
+void task_spawn(struct task_group*, struct task*, task_fun*, void* arg);
+void task_sync(struct task_group*);
+
+/* Loop body for parallel_for(): handles indices [LO, HI). */
+typedef void parallel_for_fun(int lo, int hi, void* aux);
+
+void parallel_for(int begin, int end, int grain, parallel_for_fun*, void* aux);
+
+#endif /* lib/user/task.h */
@@ -0,0 +1,23 @@
+#include <tls.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Next key for tls_key_create() to hand out. */
+static int next_key;
+
+/* Initializes TLS as the calling thread's thread-local storage
+   and points the thread's GS segment at it.  TLS must outlive
+   the thread's use of thread-local storage. */
+void tls_init(struct tls_block* tls) {
+  memset(tls, 0, sizeof *tls);
+  tls->self = tls;
+  tls->tid = get_tid();
+  set_thread_area(tls);
+}
+
+/* Reserves a slot in every thread's tls_block and returns its
+   key, or -1 if all TLS_SLOTS are taken.  Keys are never freed. */
+tls_key_t tls_key_create(void) {
+  int key = __sync_fetch_and_add(&next_key, 1);
+  return key < TLS_SLOTS ? key : -1;
+}
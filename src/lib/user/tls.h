@@ -0,0 +1,67 @@
+#ifndef __LIB_USER_TLS_H
+#define __LIB_USER_TLS_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/* Thread-local storage.
+
+   Each thread has a struct tls_block, set up by _start() or the
+   pthread start stub in the thread's first stack frame, and its
+   GS segment starts at that block (see set_thread_area()).  A
+   thread therefore reaches its own block with a single
+   GS-relative load, with no system call or shared table.
+
+   Libraries that need a per-thread value get a slot in every
+   thread's block from tls_key_create() and use tls_get() and
+   tls_set() on it, like variables declared `__thread'. */
+
+/* Number of keys tls_key_create() can hand out. */
+#define TLS_SLOTS 16
+
+/* A thread's thread-local storage. */
+struct tls_block {
+  struct tls_block* self; /* This block's own address. */
+  tid_t tid;              /* The thread's TID. */
+  void* slots[TLS_SLOTS]; /* Values for keys, initially NULL. */
+};
+
+/* Identifies one slot in every thread's tls_block. */
+typedef int tls_key_t;
+
+void tls_init(struct tls_block*);
+tls_key_t tls_key_create(void);
+
+/* Returns the calling thread's tls_block. */
+static inline struct tls_block* tls_self(void) {
+  struct tls_block* self;
+  asm("movl %%gs:%c1, %0" : "=r"(self) : "i"(offsetof(struct tls_block, self)));
+  return self;
+}
+
+/* Returns the calling thread's TID, like get_tid() but without a
+   system call. */
+static inline tid_t tls_tid(void) {
+  tid_t tid;
+  asm("movl %%gs:%c1, %0" : "=r"(tid) : "i"(offsetof(struct tls_block, tid)));
+  return tid;
+}
+
+/* Returns the calling thread's value for KEY. */
+static inline void* tls_get(tls_key_t key) {
+  void* value;
+  asm volatile("movl %%gs:%c1(,%2,4), %0"
+               : "=r"(value)
+               : "i"(offsetof(struct tls_block, slots)), "r"(key));
+  return value;
+}
+
+/* Sets the calling thread's value for KEY to VALUE. */
+static inline void tls_set(tls_key_t key, void* value) {
+  asm volatile("movl %0, %%gs:%c1(,%2,4)"
+               :
+               : "r"(value), "i"(offsetof(struct tls_block, slots)), "r"(key)
+               : "memory");
+}
+
+#endif /* lib/user/tls.h */
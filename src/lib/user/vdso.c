@@ -0,0 +1,57 @@
+#include <syscall.h>
+#include <vdso.h>
+
+/* The kernel data page that every process has mapped read-only
+   at VDSO_ADDR.  Volatile, because the kernel changes it behind
+   our back. */
+static const volatile struct vdso_data* const vdso = (const volatile struct vdso_data*)VDSO_ADDR;
+
+#define NSEC_PER_SEC 1000000000
+
+/* Returns true if the kernel accepts system calls by SYSENTER. */
+bool sysenter_available(void) { return vdso->sysenter != 0; }
+
+/* Returns the TID of the calling thread. */
+tid_t get_tid(void) { return vdso->tid; }
+
+/* Returns the number of timer ticks since the OS booted. */
+int64_t timer_ticks(void) {
+  uint32_t seq;
+  int64_t ticks;
+
+  /* Retry if the kernel was in the middle of an update. */
+  do {
+    seq = vdso->seq;
+    asm volatile("" : : : "memory");
+    ticks = vdso->ticks;
+    asm volatile("" : : : "memory");
+  } while ((seq & 1) != 0 || seq != vdso->seq);
+  return ticks;
+}
+
+/* Stores the current time of CLOCK in *TS.  CLOCK_MONOTONIC, the
+   only clock, counts from boot with the resolution of the
+   time-stamp counter, or of the timer tick if the counter is not
+   calibrated.  Returns 0 if successful, -1 if CLOCK is unknown. */
+int clock_gettime(int clock, struct timespec* ts) {
+  uint64_t khz = vdso->tsc_khz;
+  uint64_t cycles, ms;
+
+  if (clock != CLOCK_MONOTONIC)
+    return -1;
+
+  if (khz == 0) {
+    int64_t ticks = timer_ticks();
+    uint32_t freq = vdso->timer_freq;
+    ts->tv_sec = ticks / freq;
+    ts->tv_nsec = (long)(ticks % freq * (NSEC_PER_SEC / freq));
+    return 0;
+  }
+
+  /* Split the conversion so that it can't overflow. */
+  cycles = rdtsc() - vdso->tsc_boot;
+  ms = cycles / khz;
+  ts->tv_sec = ms / 1000;
+  ts->tv_nsec = (long)(ms % 1000 * 1000000 + cycles % khz * 1000000 / khz);
+  return 0;
+}
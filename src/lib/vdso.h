@@ -0,0 +1,24 @@
+#ifndef __LIB_VDSO_H
+#define __LIB_VDSO_H
+
+#include <stdint.h>
+
+/* User virtual address of the vDSO data page, which the kernel
+   maps read-only into every process.  It lies just below the
+   lowest pthread stack slot (see userprog/process.c). */
+#define VDSO_ADDR 0xbf000000
+
+/* Kernel data that user programs can read without a system
+   call.  The kernel updates it from the timer interrupt and the
+   scheduler. */
+struct vdso_data {
+  uint32_t seq;        /* Odd while the kernel is updating TICKS. */
+  int64_t ticks;       /* Timer ticks since the OS booted. */
+  uint32_t timer_freq; /* Timer ticks per second. */
+  uint64_t tsc_khz;    /* Time-stamp counter frequency in kHz, or 0 if not yet calibrated. */
+  uint64_t tsc_boot;   /* Time-stamp counter value at calibration. */
+  int32_t tid;         /* TID of the running thread, which on one CPU is the reader. */
+  uint32_t sysenter;   /* Nonzero if system calls may enter by SYSENTER. */
+};
+
+#endif /* lib/vdso.h */
@@ -0,0 +1,85 @@
+/* Admits two periodic real-time threads whose densities sum to
+   less than one, rejects a third that would overload the CPU,
+   and checks that the admitted threads meet every deadline.
+   Then runs a thread whose jobs use exactly their budget, which
+   is within its contract and must not count as a miss. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define JOB_CNT 10
+
+struct rt_task {
+  int64_t period;   /* Ticks between job releases. */
+  int64_t budget;   /* CPU ticks per job. */
+  int64_t deadline; /* Relative deadline in ticks. */
+  int64_t demand;   /* Ticks each job spins for. */
+};
+
+static thread_func rt_thread;
+
+static struct semaphore admit_sema;
+static struct semaphore done_sema;
+
+void test_edf_periodic(void) {
+  static struct rt_task tasks[] = {{10, 3, 10, 1}, {20, 6, 15, 1}, {10, 4, 10, 1}};
+  static const char* names[] = {"rt-a", "rt-b", "rt-c"};
+  static struct rt_task exact = {10, 3, 10, 3};
+  int i;
+
+  ASSERT(active_sched_policy == SCHED_EDF);
+
+  sema_init(&admit_sema, 0);
+  sema_init(&done_sema, 0);
+
+  /* Densities 0.3 and 0.4 fit; another 0.4 does not. */
+  for (i = 0; i < 3; i++) {
+    thread_create(names[i], PRI_DEFAULT, rt_thread, &tasks[i]);
+    sema_down(&admit_sema);
+  }
+  for (i = 0; i < 3; i++)
+    sema_down(&done_sema);
+
+  msg("%lld deadline misses.", thread_edf_deadline_misses());
+
+  /* Alone, so that nothing preempts its jobs. */
+  thread_create("rt-d", PRI_DEFAULT, rt_thread, &exact);
+  sema_down(&admit_sema);
+  sema_down(&done_sema);
+  msg("%lld deadline misses.", thread_edf_deadline_misses());
+}
+
+static void rt_thread(void* task_) {
+  struct rt_task* task = task_;
+  int64_t i;
+  int job;
+
+  if (!thread_set_edf(task->period, task->budget, task->deadline)) {
+    msg("%s rejected.", thread_name());
+    sema_up(&admit_sema);
+    sema_up(&done_sema);
+    return;
+  }
+  msg("%s admitted.", thread_name());
+  sema_up(&admit_sema);
+
+  /* Start the first job at a release, like the others. */
+  thread_edf_wait_next_period();
+
+  for (job = 0; job < JOB_CNT; job++) {
+    /* Spin for DEMAND ticks, at most the budget. */
+    for (i = 0; i < task->demand; i++) {
+      int64_t start = timer_ticks();
+      while (timer_ticks() == start)
+        continue;
+    }
+    thread_edf_wait_next_period();
+  }
+
+  thread_set_edf(0, 0, 0);
+  sema_up(&done_sema);
+}
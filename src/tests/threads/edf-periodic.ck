@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-periodic) begin
+(edf-periodic) rt-a admitted.
+(edf-periodic) rt-b admitted.
+(edf-periodic) rt-c rejected.
+(edf-periodic) 0 deadline misses.
+(edf-periodic) rt-d admitted.
+(edf-periodic) 0 deadline misses.
+(edf-periodic) end
+EOF
+pass;
@@ -0,0 +1,22 @@
+/* Checks that getrusage() charges user time to the calling
+   thread and to its process, and rejects an invalid WHO. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+  struct rusage self, thread;
+  volatile int i;
+
+  for (i = 0; i < 1000000; i++)
+    continue;
+
+  CHECK(getrusage(RUSAGE_THREAD, &thread) == 0, "getrusage(RUSAGE_THREAD)");
+  CHECK(getrusage(RUSAGE_SELF, &self) == 0, "getrusage(RUSAGE_SELF)");
+  if (thread.utime_cycles == 0)
+    fail("no user time charged to the thread");
+  if (self.utime_cycles < thread.utime_cycles)
+    fail("process has less user time than its only thread");
+  CHECK(getrusage(42, &self) == -1, "getrusage(42) fails");
+}
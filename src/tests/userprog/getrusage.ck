@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage) begin
+(getrusage) getrusage(RUSAGE_THREAD)
+(getrusage) getrusage(RUSAGE_SELF)
+(getrusage) getrusage(42) fails
+(getrusage) end
+getrusage: exit(0)
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Creates a batch of threads with pthread_create_many, each with
+   its own argument, and waits for them with pthread_join_all. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <pthread.h>
+
+#define NUM_THREADS 10
+
+// Global variables
+lock_t sum_lock;
+int sum;
+
+void thread_function(void* arg_);
+
+/* Adds this thread's argument to the shared sum */
+void thread_function(void* arg_) {
+  int* arg = (int*)arg_;
+  lock_acquire(&sum_lock);
+  sum += *arg;
+  lock_release(&sum_lock);
+}
+
+void test_main(void) {
+  int values[NUM_THREADS];
+  void* args[NUM_THREADS];
+  tid_t tids[NUM_THREADS];
+
+  lock_check_init(&sum_lock);
+  sum = 0;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    values[i] = i + 1;
+    args[i] = &values[i];
+  }
+
+  // Spawn all threads in one call
+  int created = pthread_create_many(thread_function, args, NUM_THREADS, tids);
+  if (created != NUM_THREADS)
+    fail("created %d threads instead of %d", created, NUM_THREADS);
+
+  // Wait on all threads in one call
+  if (!pthread_join_all(tids, NUM_THREADS))
+    fail("pthread_join_all failed");
+  msg("Sum is %d", sum);
+
+  // Every thread has been joined, so joining again must fail
+  if (pthread_join_all(tids, NUM_THREADS))
+    fail("joined threads twice");
+  msg("Main finished");
+}
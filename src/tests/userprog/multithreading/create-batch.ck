@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(create-batch) begin
+(create-batch) Sum is 55
+(create-batch) Main finished
+(create-batch) end
+create-batch: exit(0)
+EOF
+pass;
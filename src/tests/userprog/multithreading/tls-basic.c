@@ -0,0 +1,54 @@
+/* Gives each thread a different value for the same thread-local
+   storage key and checks that every thread sees its own value
+   and TID, even while the others are running. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <pthread.h>
+#include <syscall.h>
+#include <tls.h>
+
+#define NUM_THREADS 5
+#define ROUNDS 1000
+
+static tls_key_t key;
+static int values[NUM_THREADS + 1];
+
+void thread_function(void* arg_);
+static void check_tls(int* value);
+
+/* Claims KEY for VALUE and checks it repeatedly. */
+static void check_tls(int* value) {
+  if (tls_get(key) != NULL)
+    fail("new thread's slot is not NULL");
+  tls_set(key, value);
+
+  for (int i = 0; i < ROUNDS; i++) {
+    if (tls_get(key) != value)
+      fail("thread %d lost its value", *value);
+    if (tls_tid() != get_tid())
+      fail("thread %d has the wrong TID", *value);
+    if (tls_self()->self != tls_self())
+      fail("thread %d has a bad tls_block", *value);
+  }
+}
+
+void thread_function(void* arg_) { check_tls(arg_); }
+
+void test_main(void) {
+  tid_t tids[NUM_THREADS];
+
+  key = tls_key_create();
+  if (key < 0)
+    fail("tls_key_create failed");
+
+  for (int i = 0; i < NUM_THREADS; i++) {
+    values[i] = i + 1;
+    tids[i] = pthread_check_create(thread_function, &values[i]);
+  }
+  values[NUM_THREADS] = NUM_THREADS + 1;
+  check_tls(&values[NUM_THREADS]);
+  for (int i = 0; i < NUM_THREADS; i++)
+    pthread_check_join(tids[i]);
+  msg("Main finished");
+}
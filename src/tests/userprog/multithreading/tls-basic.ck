@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(tls-basic) begin
+(tls-basic) Main finished
+(tls-basic) end
+tls-basic: exit(0)
+EOF
+pass;
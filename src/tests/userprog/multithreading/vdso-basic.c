@@ -0,0 +1,72 @@
+/* Reads the TID, tick count, and time from the vDSO page in
+   several threads and checks that each thread sees its own TID
+   and that neither clock goes backward. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include <pthread.h>
+#include <syscall.h>
+
+#define NUM_THREADS 4
+#define ROUNDS 1000
+
+static tid_t seen_tids[NUM_THREADS];
+
+void thread_function(void* arg_);
+static void check_clocks(void);
+
+/* Checks that the tick count and clock_gettime() never go
+   backward. */
+static void check_clocks(void) {
+  struct timespec prev, now;
+  int64_t prev_ticks = timer_ticks();
+
+  if (clock_gettime(CLOCK_MONOTONIC, &prev) != 0)
+    fail("clock_gettime failed");
+  for (int i = 0; i < ROUNDS; i++) {
+    int64_t ticks = timer_ticks();
+    if (ticks < prev_ticks)
+      fail("timer_ticks went backward");
+    prev_ticks = ticks;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_nsec < 0 || now.tv_nsec >= 1000000000)
+      fail("tv_nsec out of range");
+    if (now.tv_sec < prev.tv_sec || (now.tv_sec == prev.tv_sec && now.tv_nsec < prev.tv_nsec))
+      fail("clock_gettime went backward");
+    prev = now;
+  }
+}
+
+/* Records this thread's TID and checks the clocks. */
+void thread_function(void* arg_) {
+  int* idx = arg_;
+  seen_tids[*idx] = get_tid();
+  check_clocks();
+  if (get_tid() != seen_tids[*idx])
+    fail("thread %d's TID changed", *idx);
+}
+
+void test_main(void) {
+  int idx[NUM_THREADS];
+  tid_t tids[NUM_THREADS];
+  tid_t main_tid = get_tid();
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC + 1, &ts) != -1)
+    fail("clock_gettime accepted an unknown clock");
+
+  for (int i = 0; i < NUM_THREADS; i++) {
+    idx[i] = i;
+    tids[i] = pthread_check_create(thread_function, &idx[i]);
+  }
+  check_clocks();
+  for (int i = 0; i < NUM_THREADS; i++) {
+    pthread_check_join(tids[i]);
+    if (seen_tids[i] != tids[i])
+      fail("thread %d saw TID %d instead of %d", i, seen_tids[i], tids[i]);
+  }
+  if (get_tid() != main_tid)
+    fail("main thread's TID changed");
+  msg("Main finished");
+}
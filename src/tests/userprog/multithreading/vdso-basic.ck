@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(vdso-basic) begin
+(vdso-basic) Main finished
+(vdso-basic) end
+vdso-basic: exit(0)
+EOF
+pass;
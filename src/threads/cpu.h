@@ -0,0 +1,37 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+
+/* Returns the processor's time-stamp counter, which counts CPU
+   cycles since reset.  See [IA32-v2b] "RDTSC". */
+static inline uint64_t rdtsc(void) {
+  uint64_t tsc;
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
+/* Executes CPUID for LEAF and stores the resulting EAX, EBX,
+   ECX, and EDX.  See [IA32-v2a] "CPUID". */
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx,
+                         uint32_t* edx) {
+  asm volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf));
+}
+
+/* CPUID leaf 1 EDX feature flags. */
+#define CPUID_1_EDX_SEP (1u << 11) /* SYSENTER and SYSEXIT. */
+
+/* Model-specific registers.  See [IA32-v3a] 5.8.7 "Performing
+   Fast Calls to System Procedures with the SYSENTER and SYSEXIT
+   Instructions". */
+#define MSR_SYSENTER_CS 0x174  /* Kernel code selector for SYSENTER. */
+#define MSR_SYSENTER_ESP 0x175 /* Kernel stack pointer for SYSENTER. */
+#define MSR_SYSENTER_EIP 0x176 /* Kernel entry point for SYSENTER. */
+
+/* Writes VALUE to model-specific register MSR.  See [IA32-v2b]
+   "WRMSR". */
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+  asm volatile("wrmsr" : : "c"(msr), "A"(value));
+}
+
+#endif /* threads/cpu.h */
@@ -29,6 +29,7 @@
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #include "tests/userprog/kernel/tests.h"
 #endif
 #ifdef THREADS
@@ -114,6 +115,7 @@ int main(void) {
   input_init();
 #ifdef USERPROG
   exception_init();
+  vdso_init();
   syscall_init();
 #endif
 
@@ -263,9 +265,13 @@ static char** parse_options(char** argv) {
         scheduler_flags[SCHED_FAIR] = 1;
       else if (!strcmp(value, "mlfqs"))
         scheduler_flags[SCHED_MLFQS] = 1;
+      else if (!strcmp(value, "edf"))
+        scheduler_flags[SCHED_EDF] = 1;
       else
         PANIC("unknown scheduler option `%s' (use -h for help)", value);
     }
+    else if (!strcmp(name, "-tickless"))
+      timer_tickless = true;
 #ifdef USERPROG
     else if (!strcmp(name, "-ul"))
       user_page_limit = atoi(value);
@@ -288,7 +294,7 @@ static char** parse_options(char** argv) {
     active_sched_policy = SCHED_DEFAULT;
   else if (sched_flags_set > 1)
     PANIC("too many scheduler flags set: set at most one of \"-sched-fifo\", \"-sched-prio\", "
-          "\"-sched-fair\", \"-sched-mlfqs\"");
+          "\"-sched-fair\", \"-sched-mlfqs\", \"-sched-edf\"");
   else if (scheduler_flags[SCHED_FIFO])
     active_sched_policy = SCHED_FIFO;
   else if (scheduler_flags[SCHED_PRIO])
@@ -297,6 +303,8 @@ static char** parse_options(char** argv) {
     active_sched_policy = SCHED_FAIR;
   else if (scheduler_flags[SCHED_MLFQS])
     active_sched_policy = SCHED_MLFQS;
+  else if (scheduler_flags[SCHED_EDF])
+    active_sched_policy = SCHED_EDF;
   else
     PANIC("kernel bug in init.c: unreachable case");
 
@@ -438,6 +446,9 @@ static void usage(void) {
          "\"-sched-fair\", \"-sched-prio\".\n"
          "  -sched-prio        Use strict-priority round-robin scheduler. Mutually exclusive with "
          "\"-sched-fair\", \"-sched-mlfqs\".\n"
+         "  -sched-edf         Use earliest-deadline-first for real-time threads, strict priority "
+         "for the rest.\n"
+         "  -tickless          Stop the periodic timer interrupt while the CPU is idle.\n"
 #ifdef USERPROG
          "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif // USERPROG
@@ -318,8 +318,12 @@ static inline bool is_trap_from_userspace(struct intr_frame* frame) {
    interrupted thread's registers. */
 void intr_handler(struct intr_frame* frame) {
   bool external;
+  bool from_user = (frame->cs & 3) == 3;
   intr_handler_func* handler;
 
+  if (from_user)
+    thread_account_user_entry();
+
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
@@ -355,6 +359,9 @@ void intr_handler(struct intr_frame* frame) {
     if (yield_on_return)
       thread_yield();
   }
+
+  if (from_user)
+    thread_account_user_exit();
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
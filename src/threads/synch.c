@@ -29,9 +29,29 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* One semaphore in a list. */
+struct semaphore_elem {
+  struct rb_elem elem;        /* Element in a condition's waiters tree. */
+  struct semaphore semaphore; /* This semaphore. */
+  struct thread* thread;      /* The one thread waiting on `semaphore'. */
+  struct condition* cond;     /* Condition whose waiters tree holds `elem'. */
+};
+
+static bool sema_waiter_less(const struct rb_elem*, const struct rb_elem*, void*);
+static bool cond_waiter_less(const struct rb_elem*, const struct rb_elem*, void*);
+static bool held_lock_less(const struct rb_elem*, const struct rb_elem*, void*);
+static void lock_take(struct lock*, struct thread*);
+
+/* Longest chain of lock holders that a single donation is
+   propagated along.  A waiter that would donate further leaves
+   the rest of the chain at its old priority, which bounds the
+   time spent with interrupts off in lock_acquire(). */
+#define DONATION_DEPTH_MAX 8
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -45,7 +65,18 @@ void sema_init(struct semaphore* sema, unsigned value) {
   ASSERT(sema != NULL);
 
   sema->value = value;
-  list_init(&sema->waiters);
+  rb_init(&sema->waiters, sema_waiter_less, NULL);
+}
+
+/* Orders semaphore waiters so that the highest effective
+   priority comes first.  Equal priorities are served FIFO,
+   because rb_insert() places an element after its equals. */
+static bool sema_waiter_less(const struct rb_elem* a_, const struct rb_elem* b_,
+                             void* aux UNUSED) {
+  const struct thread* a = rb_entry(a_, struct thread, sema_elem);
+  const struct thread* b = rb_entry(b_, struct thread, sema_elem);
+
+  return a->effective_priority > b->effective_priority;
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -63,7 +94,9 @@ void sema_down(struct semaphore* sema) {
 
   old_level = intr_disable();
   while (sema->value == 0) {
-    list_push_back(&sema->waiters, &thread_current()->sema_elem);
+    struct thread* cur = thread_current();
+    cur->waiting_sema = sema;
+    rb_insert(&sema->waiters, &cur->sema_elem);
     thread_block();
   }
   sema->value--;
@@ -101,30 +134,13 @@ void sema_up(struct semaphore* sema) {
 
   ASSERT(sema != NULL);
 
-  /*TODO: currently sema_up's implementation takes an arbitrary thread from the semaphore's
-  list of waiters, and schedules that thread by putting it on the ready-queue using thread_unblock*/
+  /* The waiters tree is kept in priority order, so the thread to
+     wake is always its cached minimum. */
   old_level = intr_disable();
-  if (!list_empty(&sema->waiters)) {
-    // Original: 
-    // if (!list_empty(&sema->waiters))
-    // thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
-    // Note: this picks sema's waiters in FIFO order to be added to the ready_queue
-    // Note: thread_unblock --> thread_enqueue --> adds the thread to the ready_queue 
-    // (then, the scheduler picks which thread to put on the CPU from the ready queue)
-
-    // Assuming active_sched_policy == SCHED_PRIO
-    /* When choosing which waiting thread to wake up and be added to ready queue, iterate through
-    sema's list of waiters and pikc the thread with the highest priority to add to ready queue. */
-    int highest_prio = -1;
-    struct thread* chosen_thread;
-    for (struct list_elem* e = list_begin(&sema->waiters); e != list_end(&sema->waiters); e = list_next(e)) {
-      struct thread* t = list_entry(e, struct thread, sema_elem);
-      if (t->effective_priority > highest_prio) {
-        highest_prio = t->effective_priority;
-        chosen_thread = t;
-      }
-    }
-    list_remove(&chosen_thread->sema_elem);
+  if (!rb_empty(&sema->waiters)) {
+    struct thread* chosen_thread = rb_entry(rb_min(&sema->waiters), struct thread, sema_elem);
+    rb_remove(&sema->waiters, &chosen_thread->sema_elem);
+    chosen_thread->waiting_sema = NULL;
     thread_unblock(chosen_thread);
 
     if (chosen_thread->effective_priority > thread_current()->effective_priority) {
@@ -196,22 +212,81 @@ void lock_init(struct lock* lock) {
   ASSERT(lock != NULL);
 
   lock->holder = NULL;
+  lock->max_priority = -1;
   sema_init(&lock->semaphore, 1);
 }
 
-/* Proj2 recursive donation */
-static void donate(struct thread* holder, int prio) {
-  // if (holder == NULL) {
-  //   return;
-  // }
-  if (holder->effective_priority < prio) {
-    holder->effective_priority = prio;
-  }
-  if (holder->donated_to != NULL) {
-    donate(holder->donated_to, prio);
+/* Initializes the synchronization state of new thread T. */
+void synch_thread_init(struct thread* t) {
+  rb_init(&t->held_locks, held_lock_less, NULL);
+  t->waiting_on = NULL;
+  t->waiting_sema = NULL;
+  t->cond_waiter = NULL;
+}
+
+/* Orders a thread's held locks so that the one with the highest
+   donated priority comes first. */
+static bool held_lock_less(const struct rb_elem* a_, const struct rb_elem* b_, void* aux UNUSED) {
+  const struct lock* a = rb_entry(a_, struct lock, held_elem);
+  const struct lock* b = rb_entry(b_, struct lock, held_elem);
+
+  return a->max_priority > b->max_priority;
+}
+
+/* Returns the highest priority donated to T through the locks
+   it holds, or -1 if there is none.  Interrupts must be off. */
+int synch_donated_priority(const struct thread* t) {
+  struct rb_elem* e = rb_min(&t->held_locks);
+  return e != NULL ? rb_entry(e, struct lock, held_elem)->max_priority : -1;
+}
+
+/* Sets LOCK's donated priority to PRIORITY, keeping its place in
+   the holder's held_locks in order. */
+static void lock_set_max_priority(struct lock* lock, int priority) {
+  struct thread* holder = lock->holder;
+
+  if (holder != NULL)
+    rb_remove(&holder->held_locks, &lock->held_elem);
+  lock->max_priority = priority;
+  if (holder != NULL)
+    rb_insert(&holder->held_locks, &lock->held_elem);
+}
+
+/* Proj2 donation: donates PRIO through LOCK to its holder, then
+   on to whatever lock that holder is waiting for, and so on up
+   the chain for at most DONATION_DEPTH_MAX locks.  Each step
+   stops early once it no longer raises anything, because the
+   rest of the chain already runs at PRIO or above. */
+static void donate(struct lock* lock, int prio) {
+  for (int depth = 0; lock != NULL && depth < DONATION_DEPTH_MAX; depth++) {
+    struct thread* holder = lock->holder;
+
+    if (holder == NULL || prio <= lock->max_priority)
+      break;
+    lock_set_max_priority(lock, prio);
+
+    if (prio <= holder->effective_priority)
+      break;
+    thread_set_effective_priority(holder, prio);
+    lock = holder->waiting_on;
   }
 }
 
+/* Makes T the holder of LOCK, which T has just acquired.  The
+   threads still waiting for LOCK now donate to T.  Interrupts
+   must be off. */
+static void lock_take(struct lock* lock, struct thread* t) {
+  struct rb_elem* top = rb_min(&lock->semaphore.waiters);
+
+  lock->holder = t;
+  lock->max_priority = top != NULL ? rb_entry(top, struct thread, sema_elem)->effective_priority : -1;
+  rb_insert(&t->held_locks, &lock->held_elem);
+
+  /* MLFQS computes every priority itself, so no donation there. */
+  if (active_sched_policy != SCHED_MLFQS && lock->max_priority > t->effective_priority)
+    thread_set_effective_priority(t, lock->max_priority);
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -230,31 +305,29 @@ void lock_acquire(struct lock* lock) {
   struct thread *current_thread = thread_current();
   struct thread *holder = lock->holder;
   if (holder != NULL) {
-    if (current_thread->effective_priority > holder->effective_priority) {
-    // add myself to the holder thread's donors list
-      list_push_front(&holder->donors, &current_thread->donors_list_elem);
-    // donate priority to holder, recursively update holder's donated_to threads
-      donate(holder, current_thread->effective_priority);
-    // keep track my donated_to thread to holder
-      current_thread->donated_to = holder;
-    }
     // rememeber that I'm waiting on this lock
-    current_thread->waiting_on = lock;  
+    current_thread->waiting_on = lock;
+    /* MLFQS computes every priority itself, so no donation there. */
+    if (active_sched_policy != SCHED_MLFQS)
+      donate(lock, current_thread->effective_priority);
   }
   intr_set_level(old_level);
 
   // Original:
-  sema_down(&lock->semaphore);
+  if (holder != NULL) {
+    uint64_t start = rdtsc();
+    sema_down(&lock->semaphore);
+    thread_account_lock_wait(rdtsc() - start);
+  } else
+    sema_down(&lock->semaphore);
   // original
 
-  /* After I successfully acquire the lock (woken up from sema_down), update my donate_to and waiting_on to NULL*/
+  /* After I successfully acquire the lock (woken up from sema_down), I am no longer waiting,
+  and whoever still waits for the lock donates to me instead. */
   old_level = intr_disable();
-  current_thread->donated_to = NULL;
   current_thread->waiting_on = NULL;
+  lock_take(lock, current_thread);
   intr_set_level(old_level);
-
-  // original
-  lock->holder = thread_current();
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -270,8 +343,11 @@ bool lock_try_acquire(struct lock* lock) {
   ASSERT(!lock_held_by_current_thread(lock));
 
   success = sema_try_down(&lock->semaphore);
-  if (success)
-    lock->holder = thread_current();
+  if (success) {
+    enum intr_level old_level = intr_disable();
+    lock_take(lock, thread_current());
+    intr_set_level(old_level);
+  }
   return success;
 }
 
@@ -286,31 +362,20 @@ void lock_release(struct lock* lock) {
   /* Project 2: priority scheduler.*/
   enum intr_level old_level = intr_disable();
   struct thread *current_thread = thread_current();
-  if (!list_empty(&current_thread->donors)) {
-    /* When I release a lock, through my list of donors. If a donor is waiting on this lock that I'm releasing,
-    remove the donor. Else, if the donor is waiting on another, keep that donor's donation. */
-    struct list_elem *e = list_begin(&current_thread->donors);
-    // Initially, my new priority will be my based priority. If I still have donors who are waiting on another
-    // lock that I hold, update my priority to that donor's donation.
+  /* Dropping the lock drops the donations made through it.  My new priority is my base priority,
+  or the highest donation through another lock I still hold, which is first in held_locks. */
+  rb_remove(&current_thread->held_locks, &lock->held_elem);
+  lock->holder = NULL;
+  lock->max_priority = -1;
+  if (active_sched_policy != SCHED_MLFQS) {
     int new_prio = current_thread->priority;
-    while (e != list_end(&current_thread->donors)) {
-      struct thread* t = list_entry(e, struct thread, donors_list_elem);
-      if (t->waiting_on == lock) {
-        // remove threads waiting for this lock from my donors list
-        list_remove(&t->donors_list_elem);
-        // CHECK: need to update donor thread's donate_to and waiting_on to NULL?
-      } else if (t->effective_priority > new_prio) {
-        // look for the next max donated priority
-        new_prio = t->effective_priority;
-      }
-      e = list_next(e);
-    }
-    current_thread->effective_priority = new_prio;
+    int donated_prio = synch_donated_priority(current_thread);
+    if (donated_prio > new_prio)
+      new_prio = donated_prio;
+    thread_set_effective_priority(current_thread, new_prio);
   }
   intr_set_level(old_level);
 
-  // Original:
-  lock->holder = NULL;
   sema_up(&lock->semaphore);
   /* sema_up will call thread yield, if when this thread releases the lock and the next woken up thread has higher priority. */
 }
@@ -382,19 +447,23 @@ void rw_lock_release(struct rw_lock* rw_lock, bool reader) {
   lock_release(&rw_lock->lock);
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem {
-  struct list_elem elem;      /* List element. */
-  struct semaphore semaphore; /* This semaphore. */
-};
-
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
 void cond_init(struct condition* cond) {
   ASSERT(cond != NULL);
 
-  list_init(&cond->waiters);
+  rb_init(&cond->waiters, cond_waiter_less, NULL);
+}
+
+/* Orders condition waiters so that the highest effective
+   priority comes first, FIFO among equals. */
+static bool cond_waiter_less(const struct rb_elem* a_, const struct rb_elem* b_,
+                             void* aux UNUSED) {
+  const struct semaphore_elem* a = rb_entry(a_, struct semaphore_elem, elem);
+  const struct semaphore_elem* b = rb_entry(b_, struct semaphore_elem, elem);
+
+  return a->thread->effective_priority > b->thread->effective_priority;
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -419,6 +488,8 @@ void cond_init(struct condition* cond) {
    we need to sleep. */
 void cond_wait(struct condition* cond, struct lock* lock) {
   struct semaphore_elem waiter;
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
 
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
@@ -428,9 +499,15 @@ void cond_wait(struct condition* cond, struct lock* lock) {
   /* The condition variable's list of waiters are implemented as a list of semaphores, one for each waiting thread. 
   When a thread calls cond_wait --> creates a semaphore for that thread --> appends semaphore to cond's waiters list
   and calls sema_down to put thread to sleep, until someone calls cond_signal, which picks a thread's semaphore for 
-  waiter's list and calls sema_up. */
+  waiter's list and calls sema_up.  Interrupts are off while the tree changes, because a donation from
+  another thread can reorder it through synch_requeue_waiter(). */
   sema_init(&waiter.semaphore, 0);
-  list_push_back(&cond->waiters, &waiter.elem);
+  waiter.thread = cur;
+  waiter.cond = cond;
+  old_level = intr_disable();
+  cur->cond_waiter = &waiter;
+  rb_insert(&cond->waiters, &waiter.elem);
+  intr_set_level(old_level);
   lock_release(lock);
   sema_down(&waiter.semaphore);
   lock_acquire(lock);
@@ -450,34 +527,22 @@ void cond_signal(struct condition* cond, struct lock* lock UNUSED) {
   ASSERT(lock_held_by_current_thread(lock));
 
   /* Project 2 modifications: condition variables signaling wakes up highest priority thread. 
-  Note: condition variable's list of waiters are implemented as a list of semaphores, one for each waiting thread. 
-  So we want to iterate through the list of waiting semaphores, extract the waiting thread that is sleeping on this semaphore,
-  and check that thread's priority. */
-  if (!list_empty(&cond->waiters)) {
-    // Original: sema_up(&list_entry(list_pop_front(&cond->waiters), struct semaphore_elem, elem)->semaphore);
-    struct semaphore_elem* chosen_sema_elem;
-    struct list_elem* e;
-    int max_prio = -1;
-    for (e = list_begin(&cond->waiters); e != list_end(&cond->waiters); e = list_next(e)) {
-      /* Each entry of cond->waiters is a semaphore_elem = {struct list_elem, struct semaphore}*/
-      struct semaphore_elem* sema_elem = list_entry(e, struct semaphore_elem, elem);
-      /* Extract the semaphore struct from semaphore_elem. */
-      struct semaphore* sema = &sema_elem->semaphore;
-      /* Since each waiting thread created it's own semaphore, and called sema_down on it, that thread
-      should be the only sleeping thread on that semaphore's list of waiters. */ 
-      struct thread* t = list_entry(list_begin(&sema->waiters), struct thread, sema_elem);
-      /* Compare waiting thread's priority. */
-      if (t->effective_priority > max_prio) {
-        max_prio = t->effective_priority;
-        chosen_sema_elem = sema_elem;
-      }
-    }
-
-    /* Remove the chosen semaphore (representing the chosen waiting thread) from cond's waiters list */
-    list_remove(&chosen_sema_elem->elem);
-    /* Calls sema_up on the chosen semaphore from cond's waiters list, to wake up the chosen waiting thread. */
+  Note: condition variable's waiters are semaphore_elems, one for each waiting thread, kept in order of
+  that thread's priority, so the one to signal is the tree's minimum. */
+  enum intr_level old_level = intr_disable();
+  if (!rb_empty(&cond->waiters)) {
+    struct semaphore_elem* chosen_sema_elem =
+        rb_entry(rb_min(&cond->waiters), struct semaphore_elem, elem);
+
+    /* Remove the chosen semaphore (representing the chosen waiting thread) from cond's waiters tree */
+    rb_remove(&cond->waiters, &chosen_sema_elem->elem);
+    chosen_sema_elem->thread->cond_waiter = NULL;
+    intr_set_level(old_level);
+    /* Calls sema_up on the chosen semaphore from cond's waiters tree, to wake up the chosen waiting thread. */
     sema_up(&chosen_sema_elem->semaphore);
+    return;
   }
+  intr_set_level(old_level);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -490,6 +555,26 @@ void cond_broadcast(struct condition* cond, struct lock* lock) {
   ASSERT(cond != NULL);
   ASSERT(lock != NULL);
 
-  while (!list_empty(&cond->waiters))
+  while (!rb_empty(&cond->waiters))
     cond_signal(cond, lock);
 }
+
+/* Called with interrupts off after T's effective priority has
+   changed.  If T is waiting on a semaphore or a condition
+   variable, moves it to its new place in the waiters tree, so
+   that a donation received while blocked is honored on wakeup.
+   rb_remove() does not compare keys, so it is safe to call after
+   the priority has already been updated. */
+void synch_requeue_waiter(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (t->waiting_sema != NULL) {
+    rb_remove(&t->waiting_sema->waiters, &t->sema_elem);
+    rb_insert(&t->waiting_sema->waiters, &t->sema_elem);
+  }
+  if (t->cond_waiter != NULL) {
+    struct rb_tree* waiters = &t->cond_waiter->cond->waiters;
+    rb_remove(waiters, &t->cond_waiter->elem);
+    rb_insert(waiters, &t->cond_waiter->elem);
+  }
+}
@@ -2,12 +2,13 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <rbtree.h>
 #include <stdbool.h>
 
 /* A counting semaphore. */
 struct semaphore {
-  unsigned value;      /* Current value. */
-  struct list waiters; /* List of waiting threads. */
+  unsigned value;         /* Current value. */
+  struct rb_tree waiters; /* Waiting threads, highest priority first. */
 };
 
 void sema_init(struct semaphore*, unsigned value);
@@ -20,7 +21,8 @@ void sema_self_test(void);
 struct lock {
   struct thread* holder;      /* Thread holding lock (for debugging). */
   struct semaphore semaphore; /* Binary semaphore controlling access. */
-  struct list_elem elem;
+  struct rb_elem held_elem;   /* Element in the holder's held_locks. */
+  int max_priority;           /* Highest priority donated through this lock, or -1. */
 };
 
 void lock_init(struct lock*);
@@ -31,7 +33,7 @@ bool lock_held_by_current_thread(const struct lock*);
 
 /* Condition variable. */
 struct condition {
-  struct list waiters; /* List of waiting threads. */
+  struct rb_tree waiters; /* Waiting threads, highest priority first. */
 };
 
 void cond_init(struct condition*);
@@ -39,6 +41,10 @@ void cond_wait(struct condition*, struct lock*);
 void cond_signal(struct condition*, struct lock*);
 void cond_broadcast(struct condition*, struct lock*);
 
+void synch_thread_init(struct thread*);
+void synch_requeue_waiter(struct thread*);
+int synch_donated_priority(const struct thread*);
+
 /* Readers-writers lock. */
 #define RW_READER 1
 #define RW_WRITER 0
@@ -2,9 +2,11 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -32,8 +34,74 @@
    that are ready to run but not actually running. */
 static struct list fifo_ready_list;
 
-/* Proj2: list of processes in THREAD_READY state for strict priority scheduler */
-static struct list prio_ready_list;
+/* Proj2: ready queues for the strict priority scheduler, one FIFO
+   list per priority level.  Bit P of prio_ready_bitmap is set iff
+   prio_ready_queues[P] is non-empty, so the highest runnable level
+   is found with a single find-first-set instead of a list scan. */
+static struct list prio_ready_queues[PRI_MAX + 1];
+static uint64_t prio_ready_bitmap;
+static int prio_ready_count; /* # of threads across all the queues. */
+
+/* The MLFQS scheduler shares the per-level queues above, using
+   each thread's computed priority as its level. */
+
+/* MLFQS: system load average, an estimate of the number of
+   threads ready to run over the past minute. */
+static fixed_point_t load_avg;
+
+/* MLFQS: threads whose recent_cpu has been charged a tick since
+   their priority was last recomputed.  Between the once-a-second
+   decays these are the only threads whose priority can change,
+   so the 4-tick recomputation only walks this list. */
+static struct list mlfqs_dirty_list;
+
+/* Fair scheduler: ready threads ordered by virtual runtime.  The
+   running thread is not in the tree. */
+static struct rb_tree fair_ready_tree;
+
+/* Fair scheduler: lower bound on the vruntime of every runnable
+   thread.  Only ever increases.  New and waking threads are
+   placed relative to it, so they can't bank credit while
+   blocked and then monopolize the CPU. */
+static int64_t fair_min_vruntime;
+
+/* Fair scheduler: load weight for each priority level.  Each
+   level gets about 10% more CPU than the level below it, and
+   PRI_DEFAULT has weight FAIR_WEIGHT_DEFAULT. */
+#define FAIR_WEIGHT_DEFAULT 1024
+static const int fair_weights[PRI_MAX + 1] = {
+    53,   59,   65,   71,   78,   86,   95,   104,  114,  126,  138,  152,  167,
+    184,  203,  223,  245,  270,  297,  326,  359,  395,  434,  478,  525,  578,
+    636,  699,  769,  846,  931,  1024, 1126, 1239, 1363, 1499, 1649, 1814, 1995,
+    2195, 2415, 2656, 2922, 3214, 3535, 3889, 4278, 4705, 5176, 5693, 6263, 6889,
+    7578, 8336, 9169, 10086, 11095, 12204, 13425, 14767, 16244, 17868, 19655, 21621};
+
+/* EDF scheduler: real-time threads that have released a job and
+   have budget left, in a binary min-heap ordered by absolute
+   deadline.  Admission control caps the number of real-time
+   threads at EDF_THREAD_MAX, so the heap cannot overflow.
+   Threads that are not real-time use the per-level priority
+   queues and run only when the heap is empty. */
+#define EDF_THREAD_MAX 64
+static struct thread* edf_heap[EDF_THREAD_MAX];
+static size_t edf_heap_size;
+
+/* EDF: real-time threads that are waiting for their next job
+   release, either because the current job finished or because
+   it used up its budget.  Scanned once per tick. */
+static struct list edf_release_list;
+
+/* EDF: admitted real-time threads and the sum of their
+   densities (budget / deadline), scaled so that EDF_UTIL_ONE
+   means the whole CPU.  EDF meets every deadline as long as the
+   sum does not exceed one. */
+#define EDF_UTIL_ONE 1000000
+static int edf_thread_cnt;
+static int64_t edf_utilization;
+
+/* EDF: jobs that completed after their deadline or were cut off
+   for exceeding their budget. */
+static int64_t edf_deadline_misses;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -48,6 +116,13 @@ static struct thread* initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Pages of recently exited threads, kept so that thread_create()
+   can skip the page allocator and the zeroing of a whole page.
+   Accessed with interrupts off. */
+#define THREAD_CACHE_MAX 16
+static struct thread* thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame {
   void* eip;             /* Return address. */
@@ -59,11 +134,38 @@ struct kernel_thread_frame {
 static long long idle_ticks;   /* # of timer ticks spent idle. */
 static long long kernel_ticks; /* # of timer ticks in kernel threads. */
 static long long user_ticks;   /* # of timer ticks in user programs. */
+static long long thread_pages_reused;    /* # of thread pages taken from thread_cache. */
+static long long thread_pages_allocated; /* # of thread pages from palloc. */
+
+/* Wakeup latency: the time from thread_unblock() until the
+   thread runs, in a log2 histogram of TSC cycles for each band of
+   LATENCY_BAND_WIDTH priorities.  Bucket B counts latencies of
+   2**B up to 2**(B+1) cycles; the last bucket also takes anything
+   longer. */
+#define LATENCY_BAND_WIDTH 8
+#define LATENCY_BANDS ((PRI_MAX + 1) / LATENCY_BAND_WIDTH)
+#define LATENCY_BUCKETS 40
+static unsigned latency_hist[LATENCY_BANDS][LATENCY_BUCKETS];
+
+/* Scheduler names, indexed by enum sched_policy. */
+static const char* sched_policy_names[] = {"fifo", "prio", "fair", "mlfqs", "edf"};
 
 /* Scheduling. */
 #define TIME_SLICE 4          /* # of timer ticks to give each thread. */
 static unsigned thread_ticks; /* # of timer ticks since last yield. */
 
+/* MLFQS. */
+#define MLFQS_PRIORITY_TICKS 4 /* # of timer ticks between priority updates. */
+
+/* Fair scheduler.  Virtual runtime is measured in units of
+   1/FAIR_TICK of a timer tick at FAIR_WEIGHT_DEFAULT. */
+#define FAIR_TICK (1 << 16)              /* vruntime of one tick at default weight. */
+#define FAIR_WAKEUP_GRANULARITY FAIR_TICK /* vruntime lead needed to preempt. */
+#define FAIR_SLEEPER_CREDIT FAIR_TICK     /* Most vruntime a waking thread is owed. */
+
+/* EDF. */
+#define is_edf_thread(T) ((T)->edf_period != 0)
+
 static void init_thread(struct thread*, const char* name, int priority);
 static bool is_thread(struct thread*) UNUSED;
 static void* alloc_frame(struct thread*, size_t size);
@@ -72,21 +174,57 @@ static void thread_enqueue(struct thread* t);
 static tid_t allocate_tid(void);
 void thread_switch_tail(struct thread* prev);
 
+static void usage_charge(struct thread* t, bool user);
+static void latency_record(struct thread* t, uint64_t now);
+static void latency_print(void);
+
 static void kernel_thread(thread_func*, void* aux);
+static struct thread* thread_page_alloc(void);
+static void thread_page_free(struct thread*);
 static void idle(void* aux UNUSED);
 static struct thread* running_thread(void);
 
 static struct thread* next_thread_to_run(void);
+
+static int sleep_wheel_slot(int64_t time, int level);
+static void sleep_wheel_insert(struct thread* t);
+static bool sleep_priority_greater(const struct list_elem* a, const struct list_elem* b,
+                                   void* aux);
 static struct thread* thread_schedule_fifo(void);
 static struct thread* thread_schedule_prio(void);
 static struct thread* thread_schedule_fair(void);
 static struct thread* thread_schedule_mlfqs(void);
+static struct thread* thread_schedule_edf(void);
 static struct thread* thread_schedule_reserved(void);
 
+static void prio_queue_push(struct thread* t);
+static void prio_queue_remove(struct thread* t);
+static int prio_queue_highest(void);
+
+static bool requeue_on_priority_change(struct thread* t);
+static void mlfqs_tick(struct thread* t);
+static void mlfqs_decay(void);
+static void mlfqs_decay_thread(struct thread* t, void* coef_);
+static void mlfqs_update_priority(struct thread* t);
+static void mlfqs_preempt_if_needed(struct thread* cur);
+
+static bool fair_vruntime_less(const struct rb_elem* a, const struct rb_elem* b, void* aux);
+static void fair_tick(struct thread* t);
+static void fair_place(struct thread* t);
+static void fair_update_min_vruntime(void);
+
+static int64_t edf_density(int64_t budget, int64_t deadline);
+static void edf_tick(struct thread* t);
+static void edf_enqueue(struct thread* t);
+static void edf_release_job(struct thread* t);
+static bool edf_earlier(const struct thread* a, const struct thread* b);
+static void edf_heap_push(struct thread* t);
+static struct thread* edf_heap_pop(void);
+
 /* Determines which scheduler the kernel should use.
    Controlled by the kernel command-line options
     "-sched=fifo", "-sched=prio",
-    "-sched=fair". "-sched=mlfqs"
+    "-sched=fair", "-sched=mlfqs", "-sched=edf"
    Is equal to SCHED_FIFO by default. */
 enum sched_policy active_sched_policy;
 
@@ -98,7 +236,7 @@ typedef struct thread* scheduler_func(void);
    policy in use by the kernel. */
 scheduler_func* scheduler_jump_table[8] = {thread_schedule_fifo,     thread_schedule_prio,
                                            thread_schedule_fair,     thread_schedule_mlfqs,
-                                           thread_schedule_reserved, thread_schedule_reserved,
+                                           thread_schedule_edf,      thread_schedule_reserved,
                                            thread_schedule_reserved, thread_schedule_reserved};
 
 
@@ -109,8 +247,23 @@ scheduler_func* scheduler_jump_table[8] = {thread_schedule_fifo,     thread_sche
 /*         BEGINNING OF NEW DATA STRUCTURES TO BE ADDED FOR Project 2. Added by Jimmy.             */
 /* ####################################################################################### */
 
-/* A Pintos list of thread structs that are currently sleeping. */
-static struct list sleeping_thread_list;
+/* Sleeping threads, in a hierarchical timing wheel keyed on
+   wakeup_time.  Level L has SLEEP_WHEEL_SLOTS slots, each
+   covering SLEEP_WHEEL_SLOTS^L ticks, so a thread due within
+   SLEEP_WHEEL_SLOTS ticks sits in the level-0 slot for its exact
+   tick and farther-off threads sit in coarser slots.  When
+   sleep_wheel_now crosses a level-L slot boundary, the threads
+   in that slot are cascaded down to finer levels.  A tick thus
+   touches only one slot per level and the threads that actually
+   expire, rather than every sleeper. */
+#define SLEEP_WHEEL_BITS 6
+#define SLEEP_WHEEL_SLOTS (1 << SLEEP_WHEEL_BITS)
+#define SLEEP_WHEEL_LEVELS 4
+#define SLEEP_WHEEL_SPAN ((int64_t)1 << (SLEEP_WHEEL_BITS * SLEEP_WHEEL_LEVELS))
+static struct list sleep_wheel[SLEEP_WHEEL_LEVELS][SLEEP_WHEEL_SLOTS];
+
+/* Last tick whose sleepers have been woken. */
+static int64_t sleep_wheel_now;
 
 
 /* ############################################################################################### */
@@ -142,7 +295,20 @@ void thread_init(void) {
       list_init(&fifo_ready_list);
       break;
     case SCHED_PRIO:
-      list_init(&prio_ready_list);
+    case SCHED_MLFQS:
+    case SCHED_EDF:
+      for (int i = PRI_MIN; i <= PRI_MAX; i++)
+        list_init(&prio_ready_queues[i]);
+      prio_ready_bitmap = 0;
+      prio_ready_count = 0;
+      load_avg = fix_int(0);
+      list_init(&mlfqs_dirty_list);
+      edf_heap_size = 0;
+      list_init(&edf_release_list);
+      break;
+    case SCHED_FAIR:
+      rb_init(&fair_ready_tree, fair_vruntime_less, NULL);
+      fair_min_vruntime = 0;
       break;
     default:
       break;
@@ -150,13 +316,17 @@ void thread_init(void) {
   //list_init(&fifo_ready_list);
   list_init(&all_list);
 
-  list_init(&sleeping_thread_list); // Added by Jimmy for Project 2. Initializes the sleeping_thread_list for timer interrupts.
+  for (int level = 0; level < SLEEP_WHEEL_LEVELS; level++)
+    for (int slot = 0; slot < SLEEP_WHEEL_SLOTS; slot++)
+      list_init(&sleep_wheel[level][slot]);
+  sleep_wheel_now = 0;
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread();
   init_thread(initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid();
+  initial_thread->usage_stamp = rdtsc();
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -192,6 +362,13 @@ void thread_tick(void) {
   else
     kernel_ticks++;
 
+  if (active_sched_policy == SCHED_MLFQS)
+    mlfqs_tick(t);
+  else if (active_sched_policy == SCHED_FAIR)
+    fair_tick(t);
+  else if (active_sched_policy == SCHED_EDF)
+    edf_tick(t);
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return();
@@ -201,6 +378,40 @@ void thread_tick(void) {
 void thread_print_stats(void) {
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", idle_ticks, kernel_ticks,
          user_ticks);
+  printf("Thread: %lld pages reused, %lld pages allocated\n", thread_pages_reused,
+         thread_pages_allocated);
+  if (active_sched_policy == SCHED_EDF)
+    printf("EDF: %d real-time threads, %lld deadline misses\n", edf_thread_cnt,
+           edf_deadline_misses);
+  latency_print();
+}
+
+/* Prints the wakeup latency histograms, one line per priority
+   band that saw any wakeups.  Each entry is a bucket's lower
+   bound, converted to nanoseconds, and its count. */
+static void latency_print(void) {
+  bool header = false;
+
+  for (int band = LATENCY_BANDS - 1; band >= 0; band--) {
+    unsigned total = 0;
+
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+      total += latency_hist[band][b];
+    if (total == 0)
+      continue;
+
+    if (!header) {
+      printf("Wakeup latency, %s scheduler (ns >= bound: count):\n",
+             sched_policy_names[active_sched_policy]);
+      header = true;
+    }
+    printf("  priority %2d-%2d, %u wakeups:", band * LATENCY_BAND_WIDTH,
+           (band + 1) * LATENCY_BAND_WIDTH - 1, total);
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+      if (latency_hist[band][b] != 0)
+        printf(" %lld:%u", timer_tsc_to_ns((uint64_t)1 << b), latency_hist[band][b]);
+    printf("\n");
+  }
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -229,7 +440,7 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = thread_page_alloc();
   if (t == NULL)
     return TID_ERROR;
 
@@ -242,13 +453,6 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
   init_thread(t, name, priority);
   tid = t->tid = allocate_tid();
 
-  /** Initialize the child status struct. */
-  t->self = (struct child_status *)malloc(sizeof(struct child_status));
-  t->self->tid = tid;
-  sema_init (&t->self->wait_sema, 0);
-  list_push_back (&thread_current()->childs_status_lst, &t->self->elem);
-  t->self->success = false;
-
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame(t, sizeof *kf);
   kf->eip = NULL;
@@ -313,12 +517,28 @@ static void thread_enqueue(struct thread* t) {
       list_push_back(&fifo_ready_list, &t->elem);
       break;
     case SCHED_PRIO:
-      list_push_back(&prio_ready_list, &t->ready_queue_elem);
+    case SCHED_MLFQS:
+      prio_queue_push(t);
+      break;
+    case SCHED_FAIR:
+      if (t->status == THREAD_BLOCKED)
+        fair_place(t);
+      rb_insert(&fair_ready_tree, &t->fair_elem);
+      break;
+    case SCHED_EDF:
+      if (is_edf_thread(t))
+        edf_enqueue(t);
+      else
+        prio_queue_push(t);
       break;
     default:
       PANIC("Unimplemented scheduling policy value: %d", active_sched_policy);
       break;
   }
+
+  /* Start the wakeup latency clock if T is being unblocked. */
+  if (t->status == THREAD_BLOCKED)
+    t->ready_stamp = rdtsc();
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -373,9 +593,27 @@ void thread_exit(void) {
      and schedule another process.  That process will destroy us
      when it calls thread_switch_tail(). */
   intr_disable();
-  thread_current()->self->exit = thread_current()->exit;
-  sema_up(&thread_current()->self->wait_sema);
+  if (thread_current()->self != NULL) {
+    thread_current()->self->exit = thread_current()->exit;
+    sema_up(&thread_current()->self->wait_sema);
+  }
   list_remove(&thread_current()->allelem);
+  if (thread_current()->mlfqs_dirty)
+    list_remove(&thread_current()->mlfqs_dirty_elem);
+  if (is_edf_thread(thread_current())) {
+    edf_utilization -=
+        edf_density(thread_current()->edf_budget, thread_current()->edf_deadline);
+    edf_thread_cnt--;
+  }
+#ifdef USERPROG
+  /* Leave this thread's CPU time to its process.  (A main thread
+     has already given up its PCB by now.) */
+  if (thread_current()->pcb != NULL) {
+    struct cpu_usage usage;
+    thread_get_usage(thread_current(), &usage);
+    cpu_usage_add(&thread_current()->pcb->exited_usage, &usage);
+  }
+#endif
   thread_current()->status = THREAD_DYING;
   schedule();
   NOT_REACHED();
@@ -413,27 +651,29 @@ void thread_foreach(thread_action_func* func, void* aux) {
 /* Sets the current thread's priority to NEW_PRIORITY. 
 Proj2: 1) First, update the base priority to NEW_PRIORITY. 
        2) Then, update the effective priority by:
-                new effective priority = max{NEW_priority, donor's priority for each donor}.
+                new effective priority = max{NEW_priority, priority donated through each held lock}.
        3) Yield if neccessary. */
 void thread_set_priority(int new_priority) {
   struct thread* curr_thread = thread_current();
   int old_effective_prio = curr_thread->effective_priority;
 
+  /* Under MLFQS the scheduler computes priorities itself. */
+  if (active_sched_policy == SCHED_MLFQS)
+    return;
+
   /* Update base priority */
   curr_thread->priority = new_priority; 
 
-  /* For setting the new effective priority, iterate through list of donors to find the highest
-  donor thread effective priority. Then, set this thread's effective priority to max(new_prio, max donor prio) */
-  struct list_elem* e;
+  /* The new effective priority is max(new_prio, max donated prio).  The locks this thread
+  holds are kept ordered by the priority donated through each, so that is a constant-time lookup. */
+  enum intr_level old_level = intr_disable();
   int new_effective_prio = new_priority;
-  for (e = list_begin(&curr_thread->donors); e != list_end(&curr_thread->donors); e = list_next(e)) {
-    struct thread* t = list_entry(e, struct thread, donors_list_elem);
-    if (t->effective_priority > new_effective_prio) {
-      new_effective_prio = t->effective_priority;
-    }
-  }
+  int donated_prio = synch_donated_priority(curr_thread);
+  if (donated_prio > new_effective_prio)
+    new_effective_prio = donated_prio;
 
-  curr_thread->effective_priority = new_effective_prio;
+  thread_set_effective_priority(curr_thread, new_effective_prio);
+  intr_set_level(old_level);
 
   /* If the effective priority of this thread was decreased, yield the CPU. */
   if (new_effective_prio < old_effective_prio) {
@@ -442,32 +682,145 @@ void thread_set_priority(int new_priority) {
 
 }
 
+/* Sets T's effective priority to PRIORITY.  If T is sitting in
+   the strict-priority ready queues it is moved to the queue for
+   its new level, so that the bitmap stays in sync with the lists,
+   and if T is waiting on a semaphore or condition variable it is
+   repositioned among the waiters.  All writes to effective_priority must go through here. */
+void thread_set_effective_priority(struct thread* t, int priority) {
+  enum intr_level old_level;
+
+  ASSERT(is_thread(t));
+  ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable();
+  if (t->effective_priority != priority) {
+    bool requeue = requeue_on_priority_change(t) && t->status == THREAD_READY;
+    if (requeue)
+      prio_queue_remove(t);
+    t->effective_priority = priority;
+    if (requeue)
+      prio_queue_push(t);
+    synch_requeue_waiter(t);
+  }
+  intr_set_level(old_level);
+}
+
+/* Charges T, which must be running, for the CPU time since it
+   was last charged: to user time if USER, otherwise to kernel
+   time. */
+static void usage_charge(struct thread* t, bool user) {
+  enum intr_level old_level = intr_disable();
+  uint64_t now = rdtsc();
+
+  if (user)
+    t->usage.user_cycles += now - t->usage_stamp;
+  else
+    t->usage.kernel_cycles += now - t->usage_stamp;
+  t->usage_stamp = now;
+  intr_set_level(old_level);
+}
+
+/* Called by the interrupt handler when the running thread enters
+   the kernel from user mode: the time since the last charge was
+   spent in user mode. */
+void thread_account_user_entry(void) { usage_charge(thread_current(), true); }
+
+/* Called by the interrupt handler when the running thread is
+   about to return to user mode: the time since the last charge
+   was spent in the kernel. */
+void thread_account_user_exit(void) { usage_charge(thread_current(), false); }
+
+/* Charges the running thread for CYCLES spent waiting for a
+   lock. */
+void thread_account_lock_wait(uint64_t cycles) {
+  enum intr_level old_level = intr_disable();
+  thread_current()->usage.lock_wait_cycles += cycles;
+  intr_set_level(old_level);
+}
+
+/* Stores T's CPU usage in *USAGE.  If T is the running thread,
+   the time since it last entered the kernel is included. */
+void thread_get_usage(struct thread* t, struct cpu_usage* usage) {
+  enum intr_level old_level = intr_disable();
+
+  if (t == thread_current())
+    usage_charge(t, false);
+  *usage = t->usage;
+  intr_set_level(old_level);
+}
+
+/* Records the wakeup latency of T, which was unblocked at
+   T->ready_stamp and is now running, as of TSC value NOW. */
+static void latency_record(struct thread* t, uint64_t now) {
+  uint64_t cycles = now - t->ready_stamp;
+  uint32_t hi = cycles >> 32;
+  uint32_t lo = cycles;
+  int bucket;
+
+  if (hi != 0)
+    bucket = 63 - __builtin_clz(hi);
+  else if (lo != 0)
+    bucket = 31 - __builtin_clz(lo);
+  else
+    bucket = 0;
+  if (bucket >= LATENCY_BUCKETS)
+    bucket = LATENCY_BUCKETS - 1;
+
+  latency_hist[t->effective_priority / LATENCY_BAND_WIDTH][bucket]++;
+  t->ready_stamp = 0;
+}
+
+/* Adds USAGE into SUM. */
+void cpu_usage_add(struct cpu_usage* sum, const struct cpu_usage* usage) {
+  sum->user_cycles += usage->user_cycles;
+  sum->kernel_cycles += usage->kernel_cycles;
+  sum->lock_wait_cycles += usage->lock_wait_cycles;
+  sum->nvcsw += usage->nvcsw;
+  sum->nivcsw += usage->nivcsw;
+}
+
 /* Returns the current thread's priority. */
 int thread_get_priority(void) { 
   /* Proj2 modified to return the effective priority */
   return thread_current()->effective_priority; 
 }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED) { /* Not yet implemented. */
+/* Sets the current thread's nice value to NICE, recomputes its
+   priority and yields if it no longer has the highest priority. */
+void thread_set_nice(int nice) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable();
+  cur->nice = nice;
+  if (active_sched_policy == SCHED_MLFQS) {
+    mlfqs_update_priority(cur);
+    if (prio_queue_highest() > cur->effective_priority)
+      thread_yield();
+  }
+  intr_set_level(old_level);
 }
 
 /* Returns the current thread's nice value. */
-int thread_get_nice(void) {
-  /* Not yet implemented. */
-  return 0;
-}
+int thread_get_nice(void) { return thread_current()->nice; }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void) {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int result = fix_round(fix_scale(load_avg, 100));
+  intr_set_level(old_level);
+  return result;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void) {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int result = fix_round(fix_scale(thread_current()->recent_cpu, 100));
+  intr_set_level(old_level);
+  return result;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -488,6 +841,7 @@ static void idle(void* idle_started_ UNUSED) {
     /* Let someone else run. */
     intr_disable();
     thread_block();
+    timer_tickless_enter();
 
     /* Re-enable interrupts and wait for the next one.
 
@@ -548,12 +902,29 @@ static void init_thread(struct thread* t, const char* name, int priority) {
 
   t->wakeup_time = 0; // Added by Jimmy. Initialize wakeup_time to be 0.
 
+  /* New threads inherit their parent's niceness and recent_cpu. */
+  if (t != initial_thread) {
+    t->nice = thread_current()->nice;
+    t->recent_cpu = thread_current()->recent_cpu;
+  } else {
+    t->nice = NICE_DEFAULT;
+    t->recent_cpu = fix_int(0);
+  }
+  t->mlfqs_dirty = false;
+
+  /* Start new threads at the front of the fair scheduler's
+     queue, alongside the threads that are waiting the longest. */
+  t->vruntime = fair_min_vruntime;
+
   /* Proj2 Priority Scheduler initialization */
   t->effective_priority = priority;
-  t->donated_to = NULL;
-  list_init(&t->donors);
+  synch_thread_init(t);
   lock_init(&t->change_priority_lock);
 
+  /* Under MLFQS the requested priority is ignored. */
+  if (active_sched_policy == SCHED_MLFQS)
+    mlfqs_update_priority(t);
+
   if (t==initial_thread){
     t->parent=NULL;
   }else{
@@ -587,36 +958,430 @@ static struct thread* thread_schedule_fifo(void) {
     return idle_thread;
 }
 
-/* Proj2 Strict priority scheduler */
+/* Appends T to the ready queue for its effective priority and
+   marks that level as occupied. */
+static void prio_queue_push(struct thread* t) {
+  int p = t->effective_priority;
+  list_push_back(&prio_ready_queues[p], &t->ready_queue_elem);
+  prio_ready_bitmap |= (uint64_t)1 << p;
+  prio_ready_count++;
+}
+
+/* Removes T from the ready queue for its effective priority,
+   clearing the level's bit if the queue became empty. */
+static void prio_queue_remove(struct thread* t) {
+  int p = t->effective_priority;
+  list_remove(&t->ready_queue_elem);
+  if (list_empty(&prio_ready_queues[p]))
+    prio_ready_bitmap &= ~((uint64_t)1 << p);
+  prio_ready_count--;
+}
+
+/* Returns the highest priority level with a ready thread, or -1
+   if every level is empty.  The bitmap is split into two 32-bit
+   halves so that __builtin_clz() compiles to a single BSR
+   instead of a libgcc call. */
+static int prio_queue_highest(void) {
+  uint32_t hi = prio_ready_bitmap >> 32;
+  uint32_t lo = prio_ready_bitmap;
+
+  if (hi != 0)
+    return 63 - __builtin_clz(hi);
+  if (lo != 0)
+    return 31 - __builtin_clz(lo);
+  return -1;
+}
+
+/* Proj2 Strict priority scheduler.  Picks the front of the
+   highest non-empty level, giving round-robin among equals. */
 static struct thread* thread_schedule_prio(void) {
-  struct thread* sched_thread = NULL;
-  struct list_elem* e;
-  int max_priority = -1;
-  if (list_empty(&prio_ready_list)) {
+  int p = prio_queue_highest();
+  struct thread* sched_thread;
+
+  if (p < 0)
+    return idle_thread;
+
+  sched_thread = list_entry(list_front(&prio_ready_queues[p]), struct thread, ready_queue_elem);
+  prio_queue_remove(sched_thread);
+  return sched_thread;
+}
+
+/* Fair priority scheduler.  Runs the ready thread that has
+   received the least CPU time relative to its weight, so every
+   thread makes progress in proportion to its priority's weight
+   and none can starve. */
+static struct thread* thread_schedule_fair(void) {
+  struct rb_elem* e = rb_min(&fair_ready_tree);
+  struct thread* t;
+
+  if (e == NULL)
     return idle_thread;
+
+  t = rb_entry(e, struct thread, fair_elem);
+  rb_remove(&fair_ready_tree, e);
+  fair_update_min_vruntime();
+  return t;
+}
+
+/* Orders threads in the fair scheduler's tree by vruntime. */
+static bool fair_vruntime_less(const struct rb_elem* a, const struct rb_elem* b,
+                               void* aux UNUSED) {
+  return rb_entry(a, struct thread, fair_elem)->vruntime <
+         rb_entry(b, struct thread, fair_elem)->vruntime;
+}
+
+/* Charges running thread T for one timer tick, scaled inversely
+   by its weight, and preempts it once it has pulled ahead of the
+   neediest ready thread by more than the wakeup granularity. */
+static void fair_tick(struct thread* t) {
+  struct rb_elem* e;
+
+  if (t == idle_thread)
+    return;
+
+  t->vruntime += FAIR_TICK * FAIR_WEIGHT_DEFAULT / fair_weights[t->effective_priority];
+  fair_update_min_vruntime();
+
+  e = rb_min(&fair_ready_tree);
+  if (e != NULL &&
+      t->vruntime - rb_entry(e, struct thread, fair_elem)->vruntime > FAIR_WAKEUP_GRANULARITY)
+    intr_yield_on_return();
+}
+
+/* Places T, which is becoming ready after being blocked, in
+   virtual time.  A thread that slept is credited with at most
+   FAIR_SLEEPER_CREDIT, so it runs soon after waking but cannot
+   claim the CPU for however long it was asleep. */
+static void fair_place(struct thread* t) {
+  int64_t min_vruntime = fair_min_vruntime - FAIR_SLEEPER_CREDIT;
+
+  if (t->vruntime < min_vruntime)
+    t->vruntime = min_vruntime;
+}
+
+/* Advances fair_min_vruntime to the smallest vruntime among the
+   running thread and the ready threads, if that has grown. */
+static void fair_update_min_vruntime(void) {
+  struct thread* cur = running_thread();
+  struct rb_elem* e = rb_min(&fair_ready_tree);
+  int64_t min_vruntime;
+  bool valid = false;
+
+  if (cur != idle_thread && cur->status == THREAD_RUNNING) {
+    min_vruntime = cur->vruntime;
+    valid = true;
   }
-  for (e = list_begin(&prio_ready_list); e != list_end(&prio_ready_list); e = list_next(e)) {
-    struct thread* t = list_entry(e, struct thread, ready_queue_elem);
-    if (t->effective_priority > max_priority) {
-      sched_thread = t;
-      max_priority = t->effective_priority;
+  if (e != NULL) {
+    int64_t v = rb_entry(e, struct thread, fair_elem)->vruntime;
+    if (!valid || v < min_vruntime)
+      min_vruntime = v;
+    valid = true;
+  }
+
+  if (valid && min_vruntime > fair_min_vruntime)
+    fair_min_vruntime = min_vruntime;
+}
+
+/* Returns true if the active scheduler keeps T in the
+   per-priority queues while it is ready, so that T has to move
+   to another queue when its priority changes. */
+static bool requeue_on_priority_change(struct thread* t) {
+  return active_sched_policy == SCHED_PRIO || active_sched_policy == SCHED_MLFQS ||
+         (active_sched_policy == SCHED_EDF && !is_edf_thread(t));
+}
+
+/* Multi-level feedback queue scheduler.  Priorities are kept up
+   to date by mlfqs_tick(), so picking the next thread is the same
+   bitmap lookup as the strict priority scheduler. */
+static struct thread* thread_schedule_mlfqs(void) { return thread_schedule_prio(); }
+
+/* MLFQS bookkeeping for one timer tick, with T running.
+
+   Only T's recent_cpu changes on an ordinary tick, so that is all
+   we touch.  Once per second load_avg and every thread's
+   recent_cpu are decayed in a single pass over all_list, which
+   also recomputes every priority.  On the other 4-tick
+   boundaries only the threads charged since the last
+   recomputation (mlfqs_dirty_list) can have a new priority. */
+static void mlfqs_tick(struct thread* t) {
+  int64_t now = timer_ticks();
+
+  if (t != idle_thread) {
+    t->recent_cpu = fix_add(t->recent_cpu, fix_int(1));
+    if (!t->mlfqs_dirty) {
+      t->mlfqs_dirty = true;
+      list_push_back(&mlfqs_dirty_list, &t->mlfqs_dirty_elem);
     }
   }
-  if (sched_thread == NULL) {
-    return idle_thread;
+
+  if (now % TIMER_FREQ == 0)
+    mlfqs_decay();
+  else if (now % MLFQS_PRIORITY_TICKS == 0) {
+    while (!list_empty(&mlfqs_dirty_list)) {
+      struct thread* d =
+          list_entry(list_pop_front(&mlfqs_dirty_list), struct thread, mlfqs_dirty_elem);
+      d->mlfqs_dirty = false;
+      mlfqs_update_priority(d);
+    }
+  } else
+    return;
+
+  mlfqs_preempt_if_needed(t);
+}
+
+/* Recomputes load_avg, then decays recent_cpu and recomputes the
+   priority of every thread in one pass.  The decay coefficient
+   depends only on load_avg, so it is computed once up front. */
+static void mlfqs_decay(void) {
+  int ready = prio_ready_count;
+  fixed_point_t twice_load;
+  fixed_point_t coef;
+
+  if (thread_current() != idle_thread)
+    ready++;
+  load_avg = fix_add(fix_mul(fix_frac(59, 60), load_avg), fix_scale(fix_frac(1, 60), ready));
+
+  twice_load = fix_scale(load_avg, 2);
+  coef = fix_div(twice_load, fix_add(twice_load, fix_int(1)));
+  thread_foreach(mlfqs_decay_thread, &coef);
+
+  /* Every priority is fresh now. */
+  while (!list_empty(&mlfqs_dirty_list))
+    list_entry(list_pop_front(&mlfqs_dirty_list), struct thread, mlfqs_dirty_elem)->mlfqs_dirty =
+        false;
+}
+
+/* thread_foreach() callback for mlfqs_decay(). */
+static void mlfqs_decay_thread(struct thread* t, void* coef_) {
+  fixed_point_t* coef = coef_;
+
+  if (t == idle_thread)
+    return;
+  t->recent_cpu = fix_add(fix_mul(*coef, t->recent_cpu), fix_int(t->nice));
+  mlfqs_update_priority(t);
+}
+
+/* Recomputes T's MLFQS priority from its recent_cpu and nice,
+   moving it between ready queues if necessary. */
+static void mlfqs_update_priority(struct thread* t) {
+  int priority = PRI_MAX - fix_trunc(fix_unscale(t->recent_cpu, 4)) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  t->priority = priority;
+  thread_set_effective_priority(t, priority);
+}
+
+/* Yields on return from the timer interrupt if a ready thread
+   now outranks CUR. */
+static void mlfqs_preempt_if_needed(struct thread* cur) {
+  if (cur == idle_thread ? prio_ready_count > 0
+                         : prio_queue_highest() > cur->effective_priority)
+    intr_yield_on_return();
+}
+
+/* Earliest-deadline-first scheduler.  Real-time threads with a
+   released job and budget left always run first, earliest
+   absolute deadline first; everything else is scheduled by
+   strict priority in the time they leave over. */
+static struct thread* thread_schedule_edf(void) {
+  if (edf_heap_size > 0)
+    return edf_heap_pop();
+  return thread_schedule_prio();
+}
+
+/* Makes the running thread a real-time thread under the EDF
+   scheduler.  From now on it releases a job every PERIOD ticks;
+   each job may run for at most BUDGET ticks and should complete,
+   by calling thread_edf_wait_next_period(), within DEADLINE
+   ticks of its release.  The first job is released right away.
+   A PERIOD of 0 turns the thread back into an ordinary
+   priority-scheduled thread.
+
+   Returns false, leaving the thread unchanged, if the EDF
+   scheduler is not active, the parameters are inconsistent, or
+   admitting the thread could make some real-time thread miss a
+   deadline: the total density, the sum of budget / deadline
+   over all real-time threads, may not exceed one. */
+bool thread_set_edf(int64_t period, int64_t budget, int64_t deadline) {
+  struct thread* cur = thread_current();
+  int64_t old_density = 0;
+  int64_t new_density = 0;
+  enum intr_level old_level;
+  bool success = false;
+
+  if (active_sched_policy != SCHED_EDF)
+    return false;
+  if (period != 0 && (period < 0 || budget <= 0 || budget > deadline || deadline > period))
+    return false;
+
+  old_level = intr_disable();
+  if (is_edf_thread(cur))
+    old_density = edf_density(cur->edf_budget, cur->edf_deadline);
+  if (period != 0)
+    new_density = edf_density(budget, deadline);
+
+  if (edf_utilization - old_density + new_density <= EDF_UTIL_ONE &&
+      (is_edf_thread(cur) || period == 0 || edf_thread_cnt < EDF_THREAD_MAX)) {
+    if (is_edf_thread(cur))
+      edf_thread_cnt--;
+    if (period != 0)
+      edf_thread_cnt++;
+    edf_utilization += new_density - old_density;
+
+    cur->edf_period = period;
+    cur->edf_budget = budget;
+    cur->edf_deadline = deadline;
+    cur->edf_release = timer_ticks();
+    cur->edf_pending = 0;
+    edf_release_job(cur);
+    success = true;
   }
-  list_remove(&sched_thread->ready_queue_elem);
-  return sched_thread;
+  intr_set_level(old_level);
+
+  /* A real-time thread that just lost that status may no
+     longer be the thread that should be running. */
+  if (success && period == 0)
+    thread_yield();
+  return success;
 }
 
-/* Fair priority scheduler */
-static struct thread* thread_schedule_fair(void) {
-  PANIC("Unimplemented scheduler policy: \"-sched=fair\"");
+/* Completes the running real-time thread's oldest unfinished
+   job and sleeps until its next job is released.  A job that
+   completes after its deadline counts as a deadline miss.
+
+   A job cut off at the end of its budget finishes on the budget
+   of the next job, which is then already released, so in that
+   case the thread goes straight on to that job. */
+void thread_edf_wait_next_period(void) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(!intr_context());
+  ASSERT(is_edf_thread(cur));
+
+  old_level = intr_disable();
+  ASSERT(cur->edf_pending > 0);
+  if (timer_ticks() > cur->edf_abs_deadline - (cur->edf_pending - 1) * cur->edf_period)
+    edf_deadline_misses++;
+  if (--cur->edf_pending == 0) {
+    cur->edf_release += cur->edf_period;
+    cur->edf_throttled = true;
+    thread_yield();
+  }
+  intr_set_level(old_level);
+}
+
+/* Returns the number of deadline misses the EDF scheduler has
+   counted since boot. */
+int64_t thread_edf_deadline_misses(void) {
+  enum intr_level old_level = intr_disable();
+  int64_t misses = edf_deadline_misses;
+  intr_set_level(old_level);
+  return misses;
+}
+
+/* Returns the density BUDGET / DEADLINE in units of
+   1 / EDF_UTIL_ONE of the CPU, rounded up so that admission
+   errs on the safe side. */
+static int64_t edf_density(int64_t budget, int64_t deadline) {
+  return DIV_ROUND_UP(budget * EDF_UTIL_ONE, deadline);
+}
+
+/* EDF bookkeeping for one timer tick, with T running.  Releases
+   the jobs that are due, charges T's job for the tick, cuts the
+   job off if it has used up its budget, and preempts T if a job
+   with an earlier deadline is ready. */
+static void edf_tick(struct thread* t) {
+  int64_t now = timer_ticks();
+  struct list_elem* e;
+
+  for (e = list_begin(&edf_release_list); e != list_end(&edf_release_list);) {
+    struct thread* r = list_entry(e, struct thread, edf_elem);
+    if (r->edf_release <= now) {
+      e = list_remove(e);
+      r->edf_throttled = false;
+      edf_release_job(r);
+      edf_heap_push(r);
+    } else
+      e = list_next(e);
+  }
+
+  if (is_edf_thread(t) && --t->edf_remaining <= 0) {
+    /* Budget exhausted.  The job may not run any longer without
+       stealing time reserved for other threads, so it waits for
+       the next release.  It is a miss only if it then completes
+       after its deadline; see thread_edf_wait_next_period(). */
+    t->edf_release += t->edf_period;
+    t->edf_throttled = true;
+    intr_yield_on_return();
+  } else if (edf_heap_size > 0 && (!is_edf_thread(t) || edf_earlier(edf_heap[0], t)))
+    intr_yield_on_return();
+}
+
+/* Puts real-time thread T where it belongs now that it is
+   ready: in the heap if it has a job to run, otherwise on the
+   release list until its next job is due. */
+static void edf_enqueue(struct thread* t) {
+  if (t->edf_throttled) {
+    if (t->edf_release > timer_ticks()) {
+      list_push_back(&edf_release_list, &t->edf_elem);
+      return;
+    }
+    t->edf_throttled = false;
+    edf_release_job(t);
+  }
+  edf_heap_push(t);
+}
+
+/* Starts T's job released at T->edf_release. */
+static void edf_release_job(struct thread* t) {
+  t->edf_abs_deadline = t->edf_release + t->edf_deadline;
+  t->edf_remaining = t->edf_budget;
+  t->edf_pending++;
 }
 
-/* Multi-level feedback queue scheduler */
-static struct thread* thread_schedule_mlfqs(void) {
-  PANIC("Unimplemented scheduler policy: \"-sched=mlfqs\"");
+/* Returns true if A's job is due before B's. */
+static bool edf_earlier(const struct thread* a, const struct thread* b) {
+  return a->edf_abs_deadline < b->edf_abs_deadline;
+}
+
+/* Adds T to the EDF heap. */
+static void edf_heap_push(struct thread* t) {
+  size_t i = edf_heap_size++;
+
+  ASSERT(edf_heap_size <= EDF_THREAD_MAX);
+
+  while (i > 0 && edf_earlier(t, edf_heap[(i - 1) / 2])) {
+    edf_heap[i] = edf_heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  edf_heap[i] = t;
+}
+
+/* Removes and returns the thread in the EDF heap with the
+   earliest deadline.  The heap must not be empty. */
+static struct thread* edf_heap_pop(void) {
+  struct thread* min = edf_heap[0];
+  struct thread* last = edf_heap[--edf_heap_size];
+  size_t i = 0;
+
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= edf_heap_size)
+      break;
+    if (child + 1 < edf_heap_size && edf_earlier(edf_heap[child + 1], edf_heap[child]))
+      child++;
+    if (!edf_earlier(edf_heap[child], last))
+      break;
+    edf_heap[i] = edf_heap[child];
+    i = child;
+  }
+  edf_heap[i] = last;
+  return min;
 }
 
 /* Not an actual scheduling policy — placeholder for empty
@@ -660,6 +1425,9 @@ void thread_switch_tail(struct thread* prev) {
 
   /* Start new time slice. */
   thread_ticks = 0;
+  cur->usage_stamp = rdtsc();
+  if (cur->ready_stamp != 0)
+    latency_record(cur, cur->usage_stamp);
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -673,10 +1441,46 @@ void thread_switch_tail(struct thread* prev) {
      palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    thread_page_free(prev);
   }
 }
 
+/* Returns a page for a new thread, from thread_cache if possible.
+   Only the struct thread at the bottom of the page is ever read
+   before being written, and init_thread() clears that, so the
+   page need not be zeroed. */
+static struct thread* thread_page_alloc(void) {
+  struct thread* t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  if (thread_cache_cnt > 0) {
+    t = thread_cache[--thread_cache_cnt];
+    thread_pages_reused++;
+  }
+  intr_set_level(old_level);
+
+  if (t == NULL) {
+    t = palloc_get_page(0);
+    old_level = intr_disable();
+    if (t != NULL)
+      thread_pages_allocated++;
+    intr_set_level(old_level);
+  }
+  return t;
+}
+
+/* Releases the page of dead thread T, into thread_cache if there
+   is room.  Called with interrupts off. */
+static void thread_page_free(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    thread_cache[thread_cache_cnt++] = t;
+  else
+    palloc_free_page(t);
+}
+
 /* Schedules a new thread.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
@@ -693,6 +1497,17 @@ static void schedule(void) {
   ASSERT(cur->status != THREAD_RUNNING);
   ASSERT(is_thread(next));
 
+  if (cur == idle_thread && next != idle_thread)
+    timer_tickless_exit();
+
+  usage_charge(cur, false);
+  if (cur != next) {
+    if (cur->status == THREAD_BLOCKED)
+      cur->usage.nvcsw++;
+    else if (cur->status == THREAD_READY)
+      cur->usage.nivcsw++;
+  }
+
   if (cur != next)
     prev = switch_threads(cur, next);
   thread_switch_tail(prev);
@@ -719,42 +1534,122 @@ uint32_t thread_stack_ofs = offsetof(struct thread, stack);
 /*         BEGINNING OF NEW FUNCTIONS TO BE ADDED FOR Project 2. Added by Jimmy.           */
 /* ####################################################################################### */
 
-/* Function called by a thread to put itself to sleep.
-
-  Appends an entry to the sleeping_threads_list in order to keep track that its been put
-  to sleep. Furthermore, the ticks parameter should be computed in the timer.c function
-  before being passed to this function.
+/* Function called by a thread to put itself to sleep for TICKS
+  timer ticks, which timer.c computes before calling.
 
-  Synchronization for modifying sleeping_thread_list should be handled by the timer.c
+  Synchronization for modifying the sleep wheel should be handled by the timer.c
   function since interrupts need to be disabled anyways to call thread_block(). */
 void put_me_to_sleep(int64_t ticks, struct thread *thread) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
   thread->wakeup_time = timer_ticks() + ticks; // Set the wakeup_time for the calling thread.
-  list_push_front(&sleeping_thread_list, &thread->sleep_elem); // Insert calling thread into the sleeping_thread_list.
+  sleep_wheel_insert(thread);
 }
 
-/* Function called by timer_interrupt() in ./timer.c which sweeps through the
-  sleeping_thread_list in linear time and unblocks with timer_unblock() all threads
-  whose wakeup_time attribute is less than the current CPU tick count.
+/* Function called by timer_interrupt() in ./timer.c which advances the sleep wheel
+  to the current tick and unblocks every thread whose wakeup_time has passed.
 
-  Note: timer_unblock() internally disables interrupts so no need to synchronize the same
-  way as put_me_to_sleep. */
+  Threads that wake together are unblocked in priority order, highest first, so the
+  ready queues see them in the order the scheduler would pick them. */
 void wake_sleeping_threads() {
   int64_t current_ticks = timer_ticks();
-  struct list_elem *e = list_begin(&sleeping_thread_list);
-  
-  while (e != list_end(&sleeping_thread_list)) {
+  struct list expired;
 
-    struct thread *t = list_entry(e, struct thread, sleep_elem);
+  ASSERT(intr_get_level() == INTR_OFF);
 
-    if (t->wakeup_time <= current_ticks) {
-      struct list_elem *temp = e;
-      e = list_next(e);
-      list_remove(temp);
-      thread_unblock(t);
-    } else {
-      e = list_next(e);
+  list_init(&expired);
+  while (sleep_wheel_now < current_ticks) {
+    struct list* slot;
+
+    sleep_wheel_now++;
+
+    /* Cascade, coarsest level first, every level whose slot
+       boundary we just crossed. */
+    for (int level = SLEEP_WHEEL_LEVELS - 1; level > 0; level--)
+      if ((sleep_wheel_now & ((1 << (SLEEP_WHEEL_BITS * level)) - 1)) == 0) {
+        slot = &sleep_wheel[level][sleep_wheel_slot(sleep_wheel_now, level)];
+        while (!list_empty(slot))
+          sleep_wheel_insert(list_entry(list_pop_front(slot), struct thread, sleep_elem));
+      }
+
+    slot = &sleep_wheel[0][sleep_wheel_slot(sleep_wheel_now, 0)];
+    while (!list_empty(slot))
+      list_push_back(&expired, list_pop_front(slot));
+  }
+
+  list_sort(&expired, sleep_priority_greater, NULL);
+  while (!list_empty(&expired))
+    thread_unblock(list_entry(list_pop_front(&expired), struct thread, sleep_elem));
+}
+
+/* Returns the number of ticks from now, between 1 and LIMIT,
+   until the next tick at which the timer interrupt has
+   scheduling work to do: waking a sleeper, cascading the sleep
+   wheel or releasing an EDF job.  Returns LIMIT if nothing is
+   due sooner.  Used to decide how long the idle CPU can go
+   without timer interrupts.  Must be called with interrupts off. */
+int64_t thread_ticks_until_next_event(int64_t limit) {
+  int64_t now = timer_ticks();
+  int64_t cnt;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(limit >= 1 && limit <= SLEEP_WHEEL_SLOTS);
+
+  for (cnt = 1; cnt < limit; cnt++) {
+    int64_t tick = now + cnt;
+    if ((tick & (SLEEP_WHEEL_SLOTS - 1)) == 0 ||
+        !list_empty(&sleep_wheel[0][sleep_wheel_slot(tick, 0)]))
+      break;
+  }
+
+  if (active_sched_policy == SCHED_EDF) {
+    struct list_elem* e;
+    for (e = list_begin(&edf_release_list); e != list_end(&edf_release_list); e = list_next(e)) {
+      int64_t release = list_entry(e, struct thread, edf_elem)->edf_release;
+      if (release - now < cnt)
+        cnt = release - now < 1 ? 1 : release - now;
     }
   }
+  return cnt;
+}
+
+/* Returns the index of the level-LEVEL slot that covers tick TIME. */
+static int sleep_wheel_slot(int64_t time, int level) {
+  return (time >> (SLEEP_WHEEL_BITS * level)) & (SLEEP_WHEEL_SLOTS - 1);
+}
+
+/* Puts sleeping thread T in the finest wheel slot that covers its
+   wakeup time.  A wakeup time beyond the wheel's span is filed
+   at the far edge of the top level and re-filed when that slot
+   cascades.
+
+   A thread due at sleep_wheel_now can only come from a cascade,
+   which runs before that tick's level-0 slot is collected, so
+   filing it there still wakes it on time. */
+static void sleep_wheel_insert(struct thread* t) {
+  int64_t expires = t->wakeup_time;
+  int64_t delta;
+  int level;
+
+  if (expires < sleep_wheel_now)
+    expires = sleep_wheel_now;
+  delta = expires - sleep_wheel_now;
+  if (delta >= SLEEP_WHEEL_SPAN) {
+    expires = sleep_wheel_now + SLEEP_WHEEL_SPAN - 1;
+    delta = SLEEP_WHEEL_SPAN - 1;
+  }
+
+  for (level = 0; level < SLEEP_WHEEL_LEVELS - 1; level++)
+    if (delta < (1 << (SLEEP_WHEEL_BITS * (level + 1))))
+      break;
+  list_push_back(&sleep_wheel[level][sleep_wheel_slot(expires, level)], &t->sleep_elem);
+}
+
+/* Orders sleeping threads by descending effective priority. */
+static bool sleep_priority_greater(const struct list_elem* a, const struct list_elem* b,
+                                   void* aux UNUSED) {
+  return list_entry(a, struct thread, sleep_elem)->effective_priority >
+         list_entry(b, struct thread, sleep_elem)->effective_priority;
 }
 
 
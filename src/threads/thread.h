@@ -3,6 +3,7 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
@@ -25,6 +26,21 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63     /* Highest priority. */
 
+/* Thread niceness, used by the MLFQS scheduler. */
+#define NICE_MIN -20   /* Least nice: favored by the scheduler. */
+#define NICE_DEFAULT 0 /* Default niceness. */
+#define NICE_MAX 20    /* Nicest: gives CPU time away to others. */
+
+/* CPU time and context switches charged to a thread, or summed
+   over the threads of a process.  Times are in TSC cycles. */
+struct cpu_usage {
+  uint64_t user_cycles;      /* Time running in user mode. */
+  uint64_t kernel_cycles;    /* Time running in the kernel. */
+  uint64_t lock_wait_cycles; /* Time blocked in lock_acquire(). */
+  int64_t nvcsw;             /* Voluntary context switches. */
+  int64_t nivcsw;            /* Involuntary context switches. */
+};
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -95,21 +111,23 @@ struct thread {
 
   /* For Proj2 priority scheduler*/
   int effective_priority;
-  struct list donors; /* List of donor threads that donate priority to this thread. */
-  struct thread* donated_to; /* The thread holding the lock this thread is waiting on. */
+  struct rb_tree held_locks; /* Locks this thread holds, highest max_priority first. */
   struct lock* waiting_on;   /* Pointer to the lock that this thread is waiting on. */
   struct lock change_priority_lock; // do we need it?
   struct list_elem ready_queue_elem; /* List elem for appending this thread to ready list*/
-  struct list_elem donors_list_elem; /* List elem for appending THIS thread to ANOTHER's list of donors*/
 
-  //struct list_elem cond_waiters_elem;    /* List elem for appending this thread to a cond var's list of waiters. */
-  struct list_elem sema_elem;           /* List elem for appending this thread to a semaphore's waiters list. */
+  /* Owned by synch.c. */
+  struct rb_elem sema_elem;             /* Element in a semaphore's waiters tree. */
+  struct semaphore* waiting_sema;       /* Semaphore this thread is blocked on, if any. */
+  struct semaphore_elem* cond_waiter;   /* This thread's entry in a condition's waiters, if any. */
 
 
 #ifdef USERPROG
   /* Owned by process.c. */
   struct process* pcb; /* Process control block if this thread is a userprog */
-  int process_thread_id; /* thread's id within a process */
+  struct process_thread* process_thread; /* This thread's record in its process's thread table. */
+  int stack_slot;        /* User stack slot, or -1 for the main thread's stack. */
+  uintptr_t tls_base;    /* Base of the SEL_UTLS segment; see set_thread_area(). */
 #endif
 
   /* Owned by thread.c. */
@@ -128,6 +146,33 @@ struct thread {
 
   /* Added by Jimmy for PROJECT 2. Need a new attribute to keep track of earliest wakeup time. */
   int64_t wakeup_time;
+
+  /* Owned by thread.c, used only by the MLFQS scheduler. */
+  int nice;                          /* Niceness, NICE_MIN..NICE_MAX. */
+  fixed_point_t recent_cpu;          /* Decayed CPU usage. */
+  bool mlfqs_dirty;                  /* On mlfqs_dirty_list? */
+  struct list_elem mlfqs_dirty_elem; /* recent_cpu changed since last priority update. */
+
+  /* Owned by thread.c, used only by the fair scheduler. */
+  int64_t vruntime;          /* Weighted CPU time consumed. */
+  struct rb_elem fair_elem;  /* Element in the fair scheduler's tree. */
+
+  /* Owned by thread.c, used only by the EDF scheduler.  All
+     times are in timer ticks. */
+  int64_t edf_period;        /* Time between job releases, or 0 if not real-time. */
+  int64_t edf_budget;        /* CPU time each job may use. */
+  int64_t edf_deadline;      /* Deadline of each job, relative to its release. */
+  int64_t edf_release;       /* Release time of the current or next job. */
+  int64_t edf_abs_deadline;  /* Absolute deadline of the current job. */
+  int64_t edf_remaining;     /* Budget left to the current job. */
+  int edf_pending;           /* Jobs released but not yet completed. */
+  bool edf_throttled;        /* Waiting for the next release? */
+  struct list_elem edf_elem; /* Element in the EDF release list. */
+
+  /* Owned by thread.c. */
+  struct cpu_usage usage; /* CPU accounting. */
+  uint64_t usage_stamp;   /* TSC when time was last charged to `usage'. */
+  uint64_t ready_stamp;   /* TSC when unblocked, or 0 if not waiting to run. */
 };
 
 struct child_status
@@ -146,6 +191,7 @@ enum sched_policy {
   SCHED_PRIO,  // Strict-priority scheduler with round-robin tiebreaking
   SCHED_FAIR,  // Implementation-defined fair scheduler
   SCHED_MLFQS, // Multi-level Feedback Queue Scheduler
+  SCHED_EDF,   // Earliest-deadline-first real-time class over strict priority
 };
 #define SCHED_DEFAULT SCHED_FIFO
 
@@ -180,18 +226,30 @@ void thread_foreach(thread_action_func*, void*);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_set_effective_priority(struct thread*, int);
 
 int thread_get_nice(void);
 void thread_set_nice(int);
 int thread_get_recent_cpu(void);
 int thread_get_load_avg(void);
 
+void thread_account_user_entry(void);
+void thread_account_user_exit(void);
+void thread_account_lock_wait(uint64_t cycles);
+void thread_get_usage(struct thread*, struct cpu_usage*);
+void cpu_usage_add(struct cpu_usage* sum, const struct cpu_usage* usage);
+
+bool thread_set_edf(int64_t period, int64_t budget, int64_t deadline);
+void thread_edf_wait_next_period(void);
+int64_t thread_edf_deadline_misses(void);
+
 /* ======================================================================================= */
 /*        Function signatures for new functions added for Project 2. Added by Jimmy.       */
 /* ======================================================================================= */
 
 void put_me_to_sleep(int64_t ticks, struct thread *thread);
 void wake_sleeping_threads(void);
+int64_t thread_ticks_until_next_event(int64_t limit);
 
 /* ======================================================================================= */
 
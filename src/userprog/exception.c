@@ -3,13 +3,18 @@
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "userprog/usercopy.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill(struct intr_frame*);
+static void debug_exception(struct intr_frame*);
 static void page_fault(struct intr_frame*);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -41,7 +46,7 @@ void exception_init(void) {
      caused indirectly, e.g. #DE can be caused by dividing by
      0.  */
   intr_register_int(0, 0, INTR_ON, kill, "#DE Divide Error");
-  intr_register_int(1, 0, INTR_ON, kill, "#DB Debug Exception");
+  intr_register_int(1, 0, INTR_ON, debug_exception, "#DB Debug Exception");
   intr_register_int(6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
   intr_register_int(7, 0, INTR_ON, kill, "#NM Device Not Available Exception");
   intr_register_int(11, 0, INTR_ON, kill, "#NP Segment Not Present");
@@ -99,6 +104,22 @@ static void kill(struct intr_frame* f) {
   }
 }
 
+/* Debug exception handler.  SYSENTER does not clear the trap
+   flag, so a user program that single-steps through it traps on
+   the first instruction of sysenter_entry, in kernel mode.
+   Resume instead at sysenter_entry_traced with TF clear, which
+   makes the system call and then returns with IRET to keep the
+   program single-stepping.  Anything else is handled like the
+   other exceptions. */
+static void debug_exception(struct intr_frame* f) {
+  if (f->cs == SEL_KCSEG && f->eip == sysenter_entry) {
+    f->eflags &= ~FLAG_TF;
+    f->eip = sysenter_entry_traced;
+    return;
+  }
+  kill(f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -137,6 +158,21 @@ static void page_fault(struct intr_frame* f) {
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+  /* Pages of thread stacks are mapped on first touch, whether by
+     the thread itself or by the kernel on its behalf. */
+  if (not_present && is_user_vaddr(fault_addr) && process_grow_stack(fault_addr))
+    return;
+
+  /* A kernel copy to or from user memory hit a bad user address.
+     Resume at its fixup, which makes the copy fail. */
+  if (!user && is_user_vaddr(fault_addr)) {
+    void* resume = usercopy_fixup((void*)f->eip);
+    if (resume != NULL) {
+      f->eip = resume;
+      return;
+    }
+  }
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
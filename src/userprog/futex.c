@@ -0,0 +1,97 @@
+#include "userprog/futex.h"
+#include <hash.h>
+#include <list.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "userprog/usercopy.h"
+
+/* Number of wait queues.  Each user address hashes to one. */
+#define FUTEX_BUCKETS 64
+
+/* A thread sleeping in futex_wait().  Lives on that thread's
+   kernel stack. */
+struct futex_waiter {
+  struct process* pcb;   /* Process whose address space UADDR is in. */
+  int* uaddr;            /* User address waited on. */
+  struct semaphore wake; /* Upped by futex_wake(). */
+  struct list_elem elem; /* Element in a futex_buckets list. */
+};
+
+/* Wait queues, in FIFO order.  Interrupts are turned off while a
+   queue is examined or changed: that is what makes the test of
+   the user word and the decision to sleep atomic with respect to
+   the other threads of the process.
+
+   Only threads that are actually asleep are queued, so the cost
+   of futex_wake() depends on how many threads sleep in a bucket,
+   never on how many locks and semaphores a process has created:
+   those take no kernel memory at all. */
+static struct list futex_buckets[FUTEX_BUCKETS];
+
+/* Returns the wait queue for UADDR in process PCB. */
+static struct list* futex_bucket(struct process* pcb, int* uaddr) {
+  unsigned h = hash_int((int)pcb) ^ hash_int((int)uaddr);
+  return &futex_buckets[h % FUTEX_BUCKETS];
+}
+
+/* Initializes the futex wait queues. */
+void futex_init(void) {
+  for (int i = 0; i < FUTEX_BUCKETS; i++)
+    list_init(&futex_buckets[i]);
+}
+
+/* If the int at user address UADDR in process PCB, which must be
+   the current process, still holds VAL, sleeps until a
+   futex_wake() on the same address and returns true.  Otherwise
+   returns false immediately, and the caller should re-examine
+   the word.  Also returns false if UADDR is not mapped. */
+bool futex_wait(struct process* pcb, int* uaddr, int val) {
+  struct futex_waiter w;
+  enum intr_level old_level;
+  int cur;
+
+  old_level = intr_disable();
+  if (!copy_from_user(&cur, uaddr, sizeof cur) || cur != val) {
+    intr_set_level(old_level);
+    return false;
+  }
+
+  w.pcb = pcb;
+  w.uaddr = uaddr;
+  sema_init(&w.wake, 0);
+  list_push_back(futex_bucket(pcb, uaddr), &w.elem);
+  sema_down(&w.wake);
+  intr_set_level(old_level);
+  return true;
+}
+
+/* Wakes up to CNT threads of process PCB sleeping on user
+   address UADDR, oldest first, and returns how many were
+   woken. */
+int futex_wake(struct process* pcb, int* uaddr, int cnt) {
+  struct list* bucket = futex_bucket(pcb, uaddr);
+  struct list woken;
+  struct list_elem* e;
+  enum intr_level old_level;
+  int n = 0;
+
+  /* Take the waiters off the queue first, and only then wake
+     them: sema_up() may yield to a woken thread, which could
+     change the queue under us. */
+  list_init(&woken);
+  old_level = intr_disable();
+  for (e = list_begin(bucket); e != list_end(bucket) && n < cnt;) {
+    struct futex_waiter* w = list_entry(e, struct futex_waiter, elem);
+    e = list_next(e);
+    if (w->pcb == pcb && w->uaddr == uaddr) {
+      list_remove(&w->elem);
+      list_push_back(&woken, &w->elem);
+      n++;
+    }
+  }
+  intr_set_level(old_level);
+
+  while (!list_empty(&woken))
+    sema_up(&list_entry(list_pop_front(&woken), struct futex_waiter, elem)->wake);
+  return n;
+}
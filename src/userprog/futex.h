@@ -0,0 +1,19 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include "userprog/process.h"
+
+/* Fast user-space mutexes.
+
+   User locks and semaphores are plain words in user memory that
+   are updated with atomic instructions, so the uncontended paths
+   never enter the kernel.  A thread that has to wait calls
+   futex_wait() on the word, and a thread that releases a waiter
+   calls futex_wake().  Sleepers are kept in a small hash table
+   keyed on the process and the user address. */
+
+void futex_init(void);
+bool futex_wait(struct process*, int* uaddr, int val);
+int futex_wake(struct process*, int* uaddr, int cnt);
+
+#endif /* userprog/futex.h */
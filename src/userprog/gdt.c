@@ -42,6 +42,7 @@ void gdt_init(void) {
   gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc(3);
   gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc(3);
   gdt[SEL_TSS / sizeof *gdt] = make_tss_desc(tss_get());
+  gdt_set_tls(0);
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
@@ -112,6 +113,17 @@ static uint64_t make_data_desc(int dpl) {
   return make_seg_desc(0, 0xfffff, CLS_CODE_DATA, 2, dpl, GRAN_PAGE);
 }
 
+/* Points the user thread-local storage segment at BASE.  There
+   is one such descriptor, so process_activate() sets it for each
+   thread it switches to; user code loads SEL_UTLS into GS and
+   reaches its thread's data with GS-relative addressing.  The
+   new base takes effect the next time GS is loaded, which
+   intr_exit does on every return to user mode. */
+void gdt_set_tls(uintptr_t base) {
+  gdt[SEL_UTLS / sizeof *gdt] =
+      make_seg_desc(base, 0xfffff, CLS_CODE_DATA, 2, 3, GRAN_PAGE);
+}
+
 /* Returns a descriptor for an "available" 32-bit Task-State
    Segment with its base at the given linear address, a limit of
    0x67 bytes (the size of a 32-bit TSS), and a DPL of 0.
@@ -2,14 +2,21 @@
 #define USERPROG_GDT_H
 
 #include "threads/loader.h"
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+#endif
 
 /* Segment selectors.
    More selectors are defined by the loader in loader.h. */
 #define SEL_UCSEG 0x1B /* User code selector. */
 #define SEL_UDSEG 0x23 /* User data selector. */
 #define SEL_TSS 0x28   /* Task-state segment. */
-#define SEL_CNT 6      /* Number of segments. */
+#define SEL_UTLS 0x33  /* User thread-local storage selector. */
+#define SEL_CNT 7      /* Number of segments. */
 
+#ifndef __ASSEMBLER__
 void gdt_init(void);
+void gdt_set_tls(uintptr_t base);
+#endif
 
 #endif /* userprog/gdt.h */
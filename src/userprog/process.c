@@ -9,6 +9,7 @@
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -21,6 +22,7 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 
+#include "lib/kernel/bitmap.h"
 #include "lib/kernel/list.h"
 #include "userprog/syscall.h"
 
@@ -28,8 +30,9 @@ static struct semaphore temporary;
 static thread_func start_process NO_RETURN;
 static thread_func start_pthread NO_RETURN;
 static bool load(const char* file_name, void (**eip)(void), void** esp);
-static struct lock process_threads_lock;
-bool setup_thread(void** esp, int thread_id);
+static hash_hash_func process_thread_hash;
+static hash_less_func process_thread_less;
+static hash_action_func process_thread_free;
 
 
 /* Initializes user programs in the system by ensuring the main
@@ -40,7 +43,6 @@ void userprog_init(void) {
   struct thread* t = thread_current();
   bool success;
   sema_init(&temporary, 0);
-  lock_init(&process_threads_lock);
 
   /* Allocate process control block
      It is imoprtant that this is a call to calloc and not malloc,
@@ -84,9 +86,11 @@ pid_t process_execute(const char* file_name) {
   Note: newly created thread will run <start_process> function with argument <fn_copy>,
   a copy of the command line input string. (This is again parsed in start_process --> load )*/
   tid = thread_create(extracted_name, PRI_DEFAULT, start_process, fn_copy);
-  if (tid == TID_ERROR)
+  if (tid == TID_ERROR) {
     palloc_free_page(fn_copy);
-  
+    return TID_ERROR;
+  }
+
   sema_down(&thread_current()->child_sema);
 
   if (!thread_current()->execution){
@@ -105,10 +109,23 @@ static void start_process(void* file_name_) {
   bool success, pcb_success;
   uint32_t fpu_temp[27];
 
+  /* Only user processes can be waited for, so only they get a
+     child_status, which joins our parent's list.  The parent is
+     blocked in process_execute() until we up its child_sema, so
+     nothing else can be touching that list. */
+  struct child_status* self = malloc(sizeof *self);
+  if (self != NULL) {
+    self->tid = t->tid;
+    sema_init(&self->wait_sema, 0);
+    self->exit = 0;
+    self->success = false;
+    list_push_back(&t->parent->childs_status_lst, &self->elem);
+  }
+  t->self = self;
+
   /* Allocate process control block */
-  struct process* new_pcb = malloc(sizeof(struct process));
+  struct process* new_pcb = self != NULL ? malloc(sizeof(struct process)) : NULL;
   success = pcb_success = new_pcb != NULL;
-  list_init(&new_pcb->process_threads);
 
   /* Initialize process control block */
   if (success) {
@@ -121,18 +138,25 @@ static void start_process(void* file_name_) {
     t->pcb->main_thread = t;
     strlcpy(t->pcb->process_name, t->name, sizeof t->name);
 
-    list_init(&t->pcb->file_desc_entry_list); /* Need to initialize the Pintos list representing the file table.*/
-    t->pcb->next_available_fd = 2; /* fds 0 and 1 are reserved for STDIN an STDOUT respectively.  */
-    list_init(&t->pcb->user_locks); /* Need to initialize the user locks Pintos list. */
-    list_init(&t->pcb->user_semaphores); /* Need to initialize the user semaphores Pintos list. */
-    lock_init(&t->pcb->syscall_lock);
+    t->pcb->fd_table = NULL; /* Allocated by the first open(); see fd_alloc(). */
+    t->pcb->fd_cnt = 0;
+    t->pcb->fd_map = NULL;
+    lock_init(&t->pcb->fd_lock);
+    success = hash_init(&t->pcb->process_threads, process_thread_hash, process_thread_less, NULL);
+    lock_init(&t->pcb->threads_lock);
+    t->pcb->stack_slots = NULL; /* Allocated by the first pthread; see alloc_stack_slot(). */
+    t->pcb->stack_cache_cnt = 0;
+    lock_init(&t->pcb->stack_lock);
+    t->stack_slot = -1;
+    memset(&t->pcb->exited_usage, 0, sizeof t->pcb->exited_usage);
   }
 
   /* Initialize interrupt frame and load executable. */
   if (success) {
     memset(&if_, 0, sizeof if_);
     fpu_init(&if_.fpu, &fpu_temp);
-    if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+    if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+    if_.gs = SEL_UTLS;
     if_.cs = SEL_UCSEG;
     if_.eflags = FLAG_IF | FLAG_MBS;
     success = load(file_name, &if_.eip, &if_.esp);
@@ -153,7 +177,8 @@ static void start_process(void* file_name_) {
   palloc_free_page(file_name);
   if (!success) {
     thread_current()->parent->execution = false;
-    thread_current()->self->exit = -1;
+    if (thread_current()->self != NULL)
+      thread_current()->self->exit = -1;
     sema_up(&thread_current()->parent->child_sema);
     thread_exit();
   }
@@ -216,26 +241,21 @@ void process_exit(void) {
   file_close(cur->pcb->exec);
 
 
-  /* Freeing the file descriptor table entries. */
-  while (!list_empty(&cur->pcb->file_desc_entry_list)) {
-    struct list_elem *e = list_pop_front(&cur->pcb->file_desc_entry_list);
-    struct file_desc_entry *f = list_entry(e, struct file_desc_entry, elem);
-    file_close(f->fptr);    // frees the (struct file) embeded inside file_desc_entry
-    free(f);
-  }
-
-  /* Freeing the user locks and semaphore lists. */
-  while (!list_empty(&cur->pcb->user_locks)) {
-    struct list_elem *e = list_pop_front(&cur->pcb->user_locks);
-    struct user_lock_entry *f = list_entry(e, struct user_lock_entry, elem);
-    free(f);
+  /* Closing every file still in the file descriptor table, then freeing the table. */
+  lock_acquire(&cur->pcb->fd_lock);
+  for (size_t fd = 0; fd < cur->pcb->fd_cnt; fd++) {
+    if (cur->pcb->fd_table[fd] != NULL) {
+      file_close(cur->pcb->fd_table[fd]);
+    }
   }
-
-  while (!list_empty(&cur->pcb->user_semaphores)) {
-    struct list_elem *e = list_pop_front(&cur->pcb->user_semaphores);
-    struct user_lock_entry *f = list_entry(e, struct user_sema_entry, elem);
-    free(f);
+  free(cur->pcb->fd_table);
+  if (cur->pcb->fd_map != NULL) {
+    bitmap_destroy(cur->pcb->fd_map);
   }
+  cur->pcb->fd_table = NULL;
+  cur->pcb->fd_cnt = 0;
+  cur->pcb->fd_map = NULL;
+  lock_release(&cur->pcb->fd_lock);
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -250,19 +270,16 @@ void process_exit(void) {
          that's been freed (and cleared). */
     cur->pcb->pagedir = NULL;
     pagedir_activate(NULL);
+    vdso_unmap(pd);
     pagedir_destroy(pd);
   }
-    {
-    struct list_elem *elem, *next;
-    for (elem = list_begin(&cur->pcb->process_threads); elem != list_end(&cur->pcb->process_threads);
-         elem = next) {
-      next = list_next(elem);
-      struct process_thread* process_thread = list_entry(elem, struct process_thread, process_thread_elem);
-
-      list_remove(&process_thread->process_thread_elem);
-      free(process_thread);
-    }
+
+  /* Stack pages, cached or not, went with the page directory. */
+  if (cur->pcb->stack_slots != NULL) {
+    bitmap_destroy(cur->pcb->stack_slots);
   }
+  /* Free the join records of threads nobody joined. */
+  hash_destroy(&cur->pcb->process_threads, process_thread_free);
 
   /* Free the PCB of this process and kill this thread
      Avoid race where PCB is freed before t->pcb is set to NULL
@@ -289,6 +306,12 @@ void process_activate(void) {
   /* Set thread's kernel stack for use in processing interrupts.
      This does nothing if this is not a user process. */
   tss_update();
+
+  /* Give the thread its own thread-local storage segment. */
+  gdt_set_tls(t->tls_base);
+
+  /* Let user code read its TID from the vDSO page. */
+  vdso_set_tid(t->tid);
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -516,6 +539,10 @@ bool load(const char* file_name, void (**eip)(void), void** esp) {
   if (!setup_stack(argc, argv, total_bytes, esp))   
     goto done;
 
+  /* Map the shared kernel data page. */
+  if (!vdso_map(t->pcb->pagedir))
+    goto done;
+
   /* Start address. */
   *eip = (void (*)(void))ehdr.e_entry;
 
@@ -763,172 +790,269 @@ bool is_main_thread(struct thread* t, struct process* p) { return p->main_thread
 /* Gets the PID of a process */
 pid_t get_pid(struct process* p) { return (pid_t)p->main_thread->tid; }
 
-/* Creates a new stack for the thread and sets up its arguments.
-   Stores the thread's entry point into *EIP and its initial stack
-   pointer into *ESP. Handles all cleanup if unsuccessful. Returns
-   true if successful, false otherwise.
+/* Auxiliary data for add_thread_usage(). */
+struct process_usage {
+  struct process* pcb;    /* Process whose threads to count. */
+  struct cpu_usage* sum;  /* Running total. */
+};
 
-   This function will be implemented in Project 2: Multithreading. For
-   now, it does nothing. You may find it necessary to change the
-   function signature. */
-bool setup_thread(void** esp, int thread_id) {
-  uint8_t* kpage;
+/* thread_foreach() callback for process_get_usage(). */
+static void add_thread_usage(struct thread* t, void* aux) {
+  struct process_usage* pu = aux;
+  struct cpu_usage usage;
+
+  if (t->pcb == pu->pcb) {
+    thread_get_usage(t, &usage);
+    cpu_usage_add(pu->sum, &usage);
+  }
+}
+
+/* Stores in *USAGE the CPU usage of process P: the sum over its
+   live threads and the threads that have already exited. */
+void process_get_usage(struct process* p, struct cpu_usage* usage) {
+  struct process_usage pu = {p, usage};
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  *usage = p->exited_usage;
+  thread_foreach(add_thread_usage, &pu);
+  intr_set_level(old_level);
+}
+
+/* Stack slots are packed downward from the bottom of the main
+   thread's stack region, slot 0 highest.  Only the top page of a
+   slot is mapped when it is handed out; the others, apart from
+   the guard page at the bottom, are mapped on first touch by
+   process_grow_stack(). */
+#define STACK_SLOTS_TOP ((uint8_t*)PHYS_BASE - MAX_STACK_PAGES * PGSIZE)
+#define STACK_SLOT_CNT MAX_THREADS
+
+/* Returns the address just above stack slot SLOT. */
+static uint8_t* stack_slot_top(size_t slot) { return STACK_SLOTS_TOP - slot * STACK_SLOT_SIZE; }
+
+/* Maps a zeroed page at user address UPAGE in the current
+   process.  Returns true if successful, false on failure. */
+static bool stack_map_page(uint8_t* upage) {
+  uint8_t* kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+  if (kpage == NULL) {
+    return false;
+  }
+  if (!install_page(upage, kpage, true)) {
+    palloc_free_page(kpage);
+    return false;
+  }
+  return true;
+}
+
+/* Maps the page holding user address ADDR if it lies in a stack
+   slot of the current process that is in use, other than in the
+   slot's guard page.  Returns true if ADDR is now mapped, false
+   if it does not belong to a stack or memory is exhausted. */
+bool process_grow_stack(const void* addr) {
+  struct process* pcb = thread_current()->pcb;
+  uint8_t* upage = pg_round_down(addr);
   bool success = false;
 
-  ASSERT(thread_id > 0);
+  if (pcb == NULL || pcb->pagedir == NULL || upage >= STACK_SLOTS_TOP ||
+      upage < stack_slot_top(STACK_SLOT_CNT)) {
+    return false;
+  }
+  size_t slot = (size_t)(STACK_SLOTS_TOP - upage - 1) / STACK_SLOT_SIZE;
+  if (upage == stack_slot_top(slot + 1)) {
+    return false;
+  }
 
-  // int i = thread_id;
+  lock_acquire(&pcb->stack_lock);
+  if (pcb->stack_slots != NULL && bitmap_test(pcb->stack_slots, slot)) {
+    success = pagedir_get_page(pcb->pagedir, upage) != NULL || stack_map_page(upage);
+  }
+  lock_release(&pcb->stack_lock);
+  return success;
+}
 
-  /* This allocates physical pages from user pool pf physical memory (PAL_USER) */
-  kpage = palloc_get_page(PAL_USER | PAL_ZERO);
-  // if (kpage != NULL) {
-  //   /* base is a pointer in virtual address, indicating which section of virtual address space
-  //   will be mapped to the allocated physical memory.*/
-  //   uint8_t* base = (uint8_t*)PHYS_BASE - (PGSIZE * i * 2); 
-
-  //   // use base - PGSIZE because installation of a page goes in reverse way
-  //   // as opposed to stack growth
-  //   /* Install_page sets up the mapping from virtual address to physical address in page table. */
-  //   success = install_page(base - PGSIZE, kpage, true);
-  //   if (success)
-  //     *esp = base;    // virtual address of stck pointer --> base
-  //   else
-  //     palloc_free_page(kpage);
-  // }
-
-  for (uint8_t* vaddr = ((uint8_t*)PHYS_BASE) - PGSIZE; vaddr > 0; vaddr -= PGSIZE) {
-    success = install_page(vaddr, kpage, true);
-    if (success) {
-      *esp = vaddr + PGSIZE;
-      break;
+/* Takes a stack slot for a new thread of PCB: the most recently
+   cached one if there is one, since its pages are still mapped, or
+   else the highest free slot.  Returns the slot, or -1 if none is
+   available or memory is exhausted. */
+static int alloc_stack_slot(struct process* pcb) {
+  size_t slot = BITMAP_ERROR;
+
+  lock_acquire(&pcb->stack_lock);
+  if (pcb->stack_cache_cnt > 0) {
+    slot = pcb->stack_cache[--pcb->stack_cache_cnt];
+  } else {
+    if (pcb->stack_slots == NULL) {
+      pcb->stack_slots = bitmap_create(STACK_SLOT_CNT);
+    }
+    if (pcb->stack_slots != NULL) {
+      slot = bitmap_scan_and_flip(pcb->stack_slots, 0, 1, false);
+    }
+    if (slot != BITMAP_ERROR && !stack_map_page(stack_slot_top(slot) - PGSIZE)) {
+      bitmap_reset(pcb->stack_slots, slot);
+      slot = BITMAP_ERROR;
     }
   }
+  lock_release(&pcb->stack_lock);
 
-  if (!success) {
-    palloc_free_page(kpage);
+  return slot != BITMAP_ERROR ? (int)slot : -1;
+}
+
+/* Gives stack slot SLOT back to PCB: into the cache if there is
+   room, otherwise unmapped and freed. */
+static void release_stack_slot(struct process* pcb, int slot) {
+  lock_acquire(&pcb->stack_lock);
+  if (pcb->stack_cache_cnt < STACK_CACHE_MAX) {
+    pcb->stack_cache[pcb->stack_cache_cnt++] = slot;
+  } else {
+    uint8_t* guard = stack_slot_top(slot + 1);
+    for (uint8_t* upage = stack_slot_top(slot) - PGSIZE; upage > guard; upage -= PGSIZE) {
+      void* kpage = pagedir_get_page(pcb->pagedir, upage);
+      if (kpage != NULL) {
+        pagedir_clear_page(pcb->pagedir, upage);
+        palloc_free_page(kpage);
+      }
+    }
+    bitmap_reset(pcb->stack_slots, slot);
   }
+  lock_release(&pcb->stack_lock);
+}
 
-  return success;
+/* Creates a new stack in PCB for a thread that is to run SF(TF,
+   ARG), with TF and ARG pushed as SF's arguments.  Stores the
+   thread's initial stack pointer into *ESP.  Returns the stack
+   slot, or -1 on failure. */
+static int setup_thread(struct process* pcb, pthread_fun tf, void* arg, void** esp) {
+  int slot = alloc_stack_slot(pcb);
+  if (slot < 0) {
+    return -1;
+  }
+
+  /* The slot's top page is always mapped, and we share the new
+     thread's page directory, so we can build its frame directly. */
+  uint32_t* sp = (uint32_t*)stack_slot_top(slot);
+  *--sp = 0;              // stack align
+  *--sp = 0;              // stack align
+  *--sp = (uint32_t)arg;  // push arg
+  *--sp = (uint32_t)tf;   // push tf
+  *--sp = 0;              // push fake return address
+  *esp = sp;
+  return slot;
+}
+
+/* Returns a hash value for process_thread E. */
+static unsigned process_thread_hash(const struct hash_elem* e, void* aux UNUSED) {
+  return hash_int(hash_entry(e, struct process_thread, process_thread_elem)->tid);
 }
 
+/* Returns true if process_thread A precedes process_thread B. */
+static bool process_thread_less(const struct hash_elem* a, const struct hash_elem* b,
+                                void* aux UNUSED) {
+  return hash_entry(a, struct process_thread, process_thread_elem)->tid <
+         hash_entry(b, struct process_thread, process_thread_elem)->tid;
+}
+
+/* Frees process_thread E, for hash_destroy(). */
+static void process_thread_free(struct hash_elem* e, void* aux UNUSED) {
+  free(hash_entry(e, struct process_thread, process_thread_elem));
+}
+
+/* Returns the record of PCB's thread TID, or NULL if there is none.
+   The caller must hold PCB's threads_lock. */
+static struct process_thread* process_thread_lookup(struct process* pcb, tid_t tid) {
+  struct process_thread key;
+  struct hash_elem* e;
+
+  key.tid = tid;
+  e = hash_find(&pcb->process_threads, &key.process_thread_elem);
+  return e != NULL ? hash_entry(e, struct process_thread, process_thread_elem) : NULL;
+}
+
+/* Everything start_pthread() needs to drop into user mode.  All
+   the steps that can fail have already been taken by
+   pthread_execute(), so the new thread never has to report back. */
 struct start_pthread_args {
-  stub_fun sf;
-  pthread_fun tf;
-  void* arg;
-  struct process* pcb;
-  bool setup_failed;
-  struct semaphore process_thread_setup_wait;
+  struct process* pcb;                   /* Process to join. */
+  struct process_thread* process_thread; /* Join record, owned by the process. */
+  stub_fun sf;                           /* User entry point. */
+  void* esp;                             /* Initial user stack pointer. */
+  int stack_slot;                        /* Stack slot holding esp. */
 };
 
-
 /* Starts a new thread with a new user stack running SF, which takes
    TF and ARG as arguments on its user stack. This new thread may be
    scheduled (and may even exit) before pthread_execute () returns.
    Returns the new thread's TID or TID_ERROR if the thread cannot
    be created properly.
 
-   This function will be implemented in Project 2: Multithreading and
-   should be similar to process_execute (). For now, it does nothing.
-   */
+   The stack and join record are set up here rather than by the new
+   thread, so there is no handshake with it and a caller can create
+   threads back to back at the cost of thread_create() alone. */
 tid_t pthread_execute(stub_fun sf, pthread_fun tf, void* arg) {
-  tid_t tid;
-  struct start_pthread_args* start_pthread_args = malloc(sizeof(struct start_pthread_args));
-  if (start_pthread_args == NULL) {
-    return TID_ERROR;
-  }
-
   struct thread* cur = thread_current();
+  struct process* pcb = cur->pcb;
+  struct start_pthread_args* args = malloc(sizeof *args);
+  struct process_thread* process_thread = malloc(sizeof *process_thread);
+  tid_t tid = TID_ERROR;
 
-  start_pthread_args->sf = sf;
-  start_pthread_args->tf = tf;
-  start_pthread_args->arg = arg;
-  start_pthread_args->pcb = cur->pcb;
-  sema_init(&start_pthread_args->process_thread_setup_wait, 0);
-
-  tid = thread_create(cur->name, PRI_DEFAULT, start_pthread, start_pthread_args);
-  sema_down(&start_pthread_args->process_thread_setup_wait);
-  if (tid == TID_ERROR) {
-    free(start_pthread_args);
+  if (args == NULL || process_thread == NULL) {
+    free(args);
+    free(process_thread);
     return TID_ERROR;
   }
 
-  free(start_pthread_args);
+  process_thread->thread_exited = false;
+  process_thread->thread_waiter = NULL;
+  sema_init(&process_thread->exit_wait, 0);
 
+  args->pcb = pcb;
+  args->process_thread = process_thread;
+  args->sf = sf;
+  args->stack_slot = setup_thread(pcb, tf, arg, &args->esp);
+  if (args->stack_slot >= 0) {
+    /* The new thread may run, publish its tid, and exit or be
+       joined before thread_create() returns.  Its pthread_exit()
+       and any joiner take threads_lock, so holding it until the
+       record is in the table makes them wait for it. */
+    lock_acquire(&pcb->threads_lock);
+    tid = thread_create(cur->name, PRI_DEFAULT, start_pthread, args);
+    if (tid != TID_ERROR) {
+      process_thread->tid = tid;
+      hash_insert(&pcb->process_threads, &process_thread->process_thread_elem);
+    }
+    lock_release(&pcb->threads_lock);
+    if (tid == TID_ERROR) {
+      release_stack_slot(pcb, args->stack_slot);
+    }
+  }
+  if (tid == TID_ERROR) {
+    free(args);
+    free(process_thread);
+  }
   return tid;
 }
 
-/* A thread function that creates a new user thread and starts it
-   running. Responsible for adding itself to the list of threads in
-   the PCB.
-
-   This function will be implemented in Project 2: Multithreading and
-   should be similar to start_process (). For now, it does nothing. */
+/* A thread function that starts a user thread prepared by
+   pthread_execute() running. */
 static void start_pthread(void* args_) {
   struct start_pthread_args* args = (struct start_pthread_args*)args_;
   struct intr_frame if_;
-  bool success = false;
   struct thread* t = thread_current();
 
-  struct process_thread* process_thread = malloc(sizeof(struct process_thread));
-  if (process_thread == NULL) {
-    args->setup_failed = true;
-    sema_up(&args->process_thread_setup_wait);
-    thread_exit();
-  }
-
   t->pcb = args->pcb;
+  t->process_thread = args->process_thread;
+  t->stack_slot = args->stack_slot;
   process_activate();
 
-  process_thread->tid = t->tid;
-  process_thread->thread_exited = false;
-  process_thread->thread_waiter = NULL;
-  sema_init(&process_thread->exit_wait, 0);
-
   memset(&if_, 0, sizeof if_);
-  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.gs = SEL_UTLS;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
   if_.eip = (void*)args->sf;      // set instruction pointer eip to stub_func 
+  if_.esp = args->esp;
+  free(args);
 
-  lock_acquire(&process_threads_lock);
-  t->process_thread_id = list_size(&args->pcb->process_threads) + 1;
-  list_push_back(&args->pcb->process_threads, &process_thread->process_thread_elem);
-  lock_release(&process_threads_lock);
-
-  /* Set up the stack for the newly created user pthread */
-  success = setup_thread(&if_.esp,t->process_thread_id);
-
-  if (!success) {
-    free(process_thread);
-    args->setup_failed = true;
-    sema_up(&args->process_thread_setup_wait);
-    thread_exit();
-  }
-
-  /* Notes: So far, we have create the thread stuct for the new user thread, and setup the user t hread's stack.
-  Now, we need to invoke the sstub function, which will call the user requested pthread function (with pthread_exit() at the end)
-  Therefore, just like process execute, we need to manually push the arguments required by stub func: <pthread func> and <args> onto the stack
-  And jump-start the execution of stub func by returning to user space via intr_exit (asm violatile). */
-
-  uint32_t* esp = (uint32_t*) if_.esp;
-
-  esp -= 1;
-  *esp= NULL; // stack align
-  esp -= 1;
-  *esp= NULL; // stack align
-  esp -= 1;
-  *esp = args->arg; // push arg
-  esp -= 1;
-  *esp = args->tf; // push tf
-  esp -= 1;
-  *esp = NULL; // push fake return address
-
-  if_.esp = (void **) esp;
-
-  args->setup_failed = false;
-  sema_up(&args->process_thread_setup_wait);
-
-  /* Start the user process by simulating a return from an
+  /* Start the user thread by simulating a return from an
      interrupt, implemented by intr_exit (in
      threads/intr-stubs.S).  Because intr_exit takes all of its
      arguments on the stack in the form of a `struct intr_frame',
@@ -946,45 +1070,29 @@ static void start_pthread(void* args_) {
    This function will be implemented in Project 2: Multithreading. For
    now, it does nothing. */
 tid_t pthread_join(tid_t tid) {
-  struct list_elem* e;
   struct thread* curr_thread = thread_current();
-  struct process_thread* process_thread = NULL;
-
-  lock_acquire(&process_threads_lock);
-
-  /** Looking for current process thread*/
-  for (e = list_begin(&curr_thread->pcb->process_threads); e != list_end(&curr_thread->pcb->process_threads);
-      e = list_next(e)) {
-    struct process_thread* current_process_thread =
-        list_entry(e, struct process_thread, process_thread_elem);
-    if (current_process_thread->tid == tid) {
-      process_thread = current_process_thread;
-      break;
-    }
-  }
+  struct process* pcb = curr_thread->pcb;
+
+  lock_acquire(&pcb->threads_lock);
 
- if (process_thread == NULL || process_thread->thread_waiter != NULL) {
-    lock_release(&process_threads_lock);
+  struct process_thread* process_thread = process_thread_lookup(pcb, tid);
+  if (process_thread == NULL || process_thread->thread_waiter != NULL) {
+    lock_release(&pcb->threads_lock);
     return TID_ERROR;
   }
 
-  if (process_thread->thread_exited) {
-    lock_release(&process_threads_lock);
-    return tid;
+  if (!process_thread->thread_exited) {
+    process_thread->thread_waiter = curr_thread;
+    lock_release(&pcb->threads_lock);
+    sema_down(&process_thread->exit_wait);
+    lock_acquire(&pcb->threads_lock);
   }
 
-  process_thread->thread_waiter = curr_thread;
-
-  lock_release(&process_threads_lock);
-
-  /* Fixed deadlock: when pthread join calls sema_down to sleep and wait for target thread to exit,
-  need to release the syscall_lock, so that the target thread's pthread_exit syscall can proceed. 
-  Also, need to re-acquire syscall_lock, because in syscall_handler, after this function returns,
-  the syscall_lock is released at the end.
-  (create-simple test) */
-  lock_release(&curr_thread->pcb->syscall_lock);
-  sema_down(&process_thread->exit_wait);
-  lock_acquire(&curr_thread->pcb->syscall_lock);
+  /* The thread signals exit_wait while holding threads_lock, so once we
+     hold it the thread is done with its record and we can reclaim it. */
+  hash_delete(&pcb->process_threads, &process_thread->process_thread_elem);
+  lock_release(&pcb->threads_lock);
+  free(process_thread);
   return tid;
 }
 
@@ -998,34 +1106,21 @@ tid_t pthread_join(tid_t tid) {
    This function will be implemented in Project 2: Multithreading. For
    now, it does nothing. */
 void pthread_exit(void) {
-  struct list_elem* e;
   struct thread* curr_thread = thread_current();
-
-  struct process_thread* process_thread = NULL;
-
-  lock_acquire(&process_threads_lock);
-
-  for (e = list_begin(&curr_thread->pcb->process_threads); e != list_end(&curr_thread->pcb->process_threads);
-       e = list_next(e)) {
-    struct process_thread* current_process_thread =
-        list_entry(e, struct process_thread, process_thread_elem);
-    if (current_process_thread->tid == curr_thread->tid) {
-      process_thread = current_process_thread;
-      break;
-    }
-  }
+  struct process_thread* process_thread = curr_thread->process_thread;
 
   ASSERT(process_thread != NULL);
 
-  process_thread->thread_exited = true;
-
-  lock_release(&process_threads_lock);
+  release_stack_slot(curr_thread->pcb, curr_thread->stack_slot);
+  curr_thread->stack_slot = -1;
 
-  /* When pthread_exit finished exiting and calls sema_up to signal waiter (the thread that called join on me)
-  need to relinquish the syscall_lock, because pthread_join re-acquires syscall_lock after waking up from sema_down.
-  Since this function exists the thread and never returns, don't need to re-acquire lock. */
-  lock_release(&curr_thread->pcb->syscall_lock);
+  /* Signal the waiter (the thread that called join on me), if any.  A joiner
+     may free the record as soon as we release threads_lock. */
+  lock_acquire(&curr_thread->pcb->threads_lock);
+  process_thread->thread_exited = true;
   sema_up(&process_thread->exit_wait);
+  curr_thread->process_thread = NULL;
+  lock_release(&curr_thread->pcb->threads_lock);
 
   thread_exit();
 }
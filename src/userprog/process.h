@@ -2,19 +2,22 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
+#include "lib/kernel/hash.h"
 #include "lib/kernel/list.h"
+#include <stack-slot.h>
 #include <stdint.h>
 
 #include "threads/synch.h"
 
-typedef char lock_t;
-typedef char sema_t;
-
 // At most 8MB can be allocated to the stack
 // These defines will be used in Project 2: Multithreading
 #define MAX_STACK_PAGES (1 << 11)
 #define MAX_THREADS 127
 
+/* Up to STACK_CACHE_MAX stack slots (see lib/stack-slot.h) of
+   exited threads stay mapped for reuse. */
+#define STACK_CACHE_MAX 8
+
 /* PIDs and TIDs are the same type. PID should be
    the TID of the main thread of the process */
 typedef tid_t pid_t;
@@ -23,30 +26,6 @@ typedef tid_t pid_t;
 typedef void (*pthread_fun)(void*);
 typedef void (*stub_fun)(pthread_fun, void*);
 
-/* File descriptor table entry implementing using Pintos list structures. */
-struct file_desc_entry {
-  int fd;
-  const char *file_name;
-  struct file* fptr;
-  struct list_elem elem;
-};
-
-/* An entry that stores the mapping between the lock_t that users interact with
-   and the actual lock struct. Added for Project 2. */
-struct user_lock_entry {
-  lock_t *user_lock_id; // Unique char representing a lock for a user.
-  struct lock lock; // The actual lock struct (hidden from the user).
-  struct list_elem elem; // Compatibility with Pintos lists.
-};
-
-/* An entry that stores the mapping between the lock_t that users interact with
-   and the actual lock struct. Added for Project 2. */
-struct user_sema_entry {
-  sema_t *user_sema_id; // Unique char representing a sema for a user.
-  struct semaphore sema; // The actual sema struct (hidden from the user).
-  struct list_elem elem; // Compatibility with Pintos lists.
-};
-
 /* The process control block for a given process. Since
    there can be multiple threads per process, we need a separate
    PCB from the TCB. All TCBs in a process will have a pointer
@@ -58,21 +37,28 @@ struct process {
   char process_name[16];      /* Name of the main thread */
   struct thread* main_thread; /* Pointer to main thread */
   
-  struct list file_desc_entry_list; /* File descriptor table for this process. */
-  int next_available_fd; /* Next available file descriptor for easy assignment when opening new files. */
+  struct file** fd_table; /* Open files indexed by file descriptor, NULL in unused slots. */
+  size_t fd_cnt;          /* Number of slots in fd_table. */
+  struct bitmap* fd_map;  /* Slots of fd_table in use, for lowest-free allocation. */
+  struct lock fd_lock;    /* Protects fd_table, fd_cnt, and fd_map. */
+
+  struct bitmap* stack_slots;         /* Stack slots in use or cached, NULL until the first pthread. */
+  int stack_cache[STACK_CACHE_MAX];   /* Mapped slots of exited threads, most recent last. */
+  int stack_cache_cnt;                /* Number of entries in stack_cache. */
+  struct lock stack_lock;             /* Protects the above and the mappings in stack slots. */
   struct file *exec; /* Pointer to the current file being executed. */
 
-  /* Added by Jimmy for Project 2. */
-  struct list user_locks;
-  struct list user_semaphores;
-  struct lock syscall_lock;
-
   /* Added by Fanjia for Project 2.*/
-  struct list process_threads;    /* A list of process_thread structs */
+  struct hash process_threads;    /* process_thread records of non-main threads, keyed by tid. */
+  struct lock threads_lock;       /* Protects process_threads. */
+
+  struct cpu_usage exited_usage;  /* CPU usage of this process's exited threads. */
 };
 
+/* Join record for a non-main thread.  Freed by the thread that joins
+   it, or at process exit if no thread ever does. */
 struct process_thread {
-  struct list_elem process_thread_elem;
+  struct hash_elem process_thread_elem;
   struct semaphore exit_wait; // semaphore for waiting of thread exit
   tid_t tid;
   struct thread* thread_waiter; // pointer to the thread that waits on this process_thread (via join)
@@ -86,8 +72,11 @@ int process_wait(pid_t);
 void process_exit(void);
 void process_activate(void);
 
+bool process_grow_stack(const void* addr);
+
 bool is_main_thread(struct thread*, struct process*);
 pid_t get_pid(struct process*);
+void process_get_usage(struct process*, struct cpu_usage*);
 
 tid_t pthread_execute(stub_fun, pthread_fun, void*);
 tid_t pthread_join(tid_t);
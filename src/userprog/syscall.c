@@ -3,21 +3,39 @@
 #include "lib/float.h"
 #include <string.h>
 #include <syscall-nr.h>
+#include <rusage.h>
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/futex.h"
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#include "userprog/vdso.h"
+#include "threads/cpu.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
+#include "userprog/usercopy.h"
 
 #include "threads/malloc.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "devices/input.h"
+#include "lib/kernel/bitmap.h"
 #include "lib/kernel/list.h"
 
+/* Initial number of slots in a process's file descriptor table, including the two console fds. */
+#define FD_TABLE_MIN 16
+
+/* Size of the kernel buffer that create, remove, and open copy a file name into, including the null.  No file
+   has a longer name, so those calls simply fail on one. */
+#define NAME_BUF_SIZE 128
+
 static void syscall_handler(struct intr_frame*);
-static int validate_syscall_arg(uint32_t *args UNUSED, int args_count);
+static void syscall_kill(void) NO_RETURN;
+static bool copy_name(char *name, const char *uname);
 static void syscall_halt(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static void syscall_exit(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static void syscall_exec(uint32_t *args UNUSED, uint32_t *eax UNUSED);
@@ -32,19 +50,21 @@ static void syscall_write(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static void syscall_seek(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static void syscall_tell(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static void syscall_close(uint32_t *args UNUSED, uint32_t *eax UNUSED);
-static void syscall_lock_init(uint32_t *args UNUSED, uint32_t *eax UNUSED);
-static void syscall_lock_acquire(uint32_t *args UNUSED, uint32_t *eax UNUSED);
-static void syscall_lock_release(uint32_t *args UNUSED, uint32_t *eax UNUSED);
-static void syscall_sema_init(uint32_t *args UNUSED, uint32_t *eax UNUSED);
-static void syscall_sema_up(uint32_t *args UNUSED, uint32_t *eax UNUSED);
-static void syscall_sema_down(uint32_t *args UNUSED, uint32_t *eax UNUSED);
+static void syscall_futex_wait(uint32_t *args UNUSED, uint32_t *eax UNUSED);
+static void syscall_futex_wake(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static tid_t syscall_pthread_create(uint32_t *args UNUSED);
 static void syscall_pthread_exit(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 static tid_t syscall_pthread_join(uint32_t *args UNUSED);
+static void syscall_pthread_create_many(uint32_t *args UNUSED, uint32_t *eax UNUSED);
+static void syscall_pthread_join_all(uint32_t *args UNUSED, uint32_t *eax UNUSED);
+static void syscall_getrusage(uint32_t *args UNUSED, uint32_t *eax UNUSED);
+static void syscall_get_tid(uint32_t *args UNUSED, uint32_t *eax UNUSED);
+static void syscall_set_thread_area(uint32_t *args UNUSED, uint32_t *eax UNUSED);
 
-struct file_desc_entry *find_entry_by_fd(int fd);
-static void find_next_available_fd(void);
-int check_bad_pointer(void *addr);
+static struct file *get_file_by_fd(int fd);
+static struct file *lookup_fd(struct process *pcb, int fd);
+static int fd_alloc(struct process *pcb, struct file *file);
+static bool fd_table_grow(struct process *pcb);
 
 int open(const char *file);
 int filesize(int fd);
@@ -54,61 +74,134 @@ void seek(int fd, unsigned position);
 unsigned tell(int fd);
 int close(int fd);
 int sys_compute_e(int n);
-int sys_lock_init(lock_t* lock);
-int sys_lock_acquire(lock_t* lock);
-int sys_lock_release(lock_t* lock);
-int sys_sema_init(lock_t* lock, int val);
-int sys_sema_up(sema_t* sema);
-int sys_sema_down(sema_t* sema);
-
-struct lock file_global_lock; /* Global file lock. Added by Jimmy. */
-
-/* Helper function for finding entries in the process file descriptor table by their file descriptor number.
-   Returns NULL if no file with the specified fd is found. */
-struct file_desc_entry *find_entry_by_fd(int fd) {
-  struct list *table = &thread_current()->pcb->file_desc_entry_list;
-  struct list_elem *e;
-  for (e = list_begin(table); e != list_end(table); e = list_next(e)) {
-    struct file_desc_entry *f = list_entry(e, struct file_desc_entry, elem);
-    if (f->fd == fd) {
-      return f;
-    }
+int sys_getrusage(int who, struct rusage* usage);
+
+
+/* Helper function for finding the open file with file descriptor number fd in the process file descriptor table.
+   Returns NULL if no file with the specified fd is found.  Otherwise the file comes with a reference of its own
+   (see file_dup()), so that another thread closing fd cannot free it under us; drop it with file_close(). */
+static struct file *get_file_by_fd(int fd) {
+  struct process *pcb = thread_current()->pcb;
+  struct file *file = NULL;
+  lock_acquire(&pcb->fd_lock);
+  struct file *f = lookup_fd(pcb, fd);
+  if (f != NULL) {
+    file = file_dup(f);
   }
-  return NULL;
+  lock_release(&pcb->fd_lock);
+  return file;
 }
 
+/* Returns the file open as fd in PCB's file descriptor table, or NULL if fd is not open.
+   The caller must hold PCB's fd_lock. */
+static struct file *lookup_fd(struct process *pcb, int fd) {
+  if (fd < 0 || (size_t) fd >= pcb->fd_cnt) {
+    return NULL;
+  }
+  return pcb->fd_table[fd];
+}
 
-/* Helper function for setting the process' next available file descriptor number for easy bookmarking when adding
-  new files in the future. */
-static void find_next_available_fd() {
-  thread_current()->pcb->next_available_fd += 1;
+/* Installs file in the lowest free slot of PCB's file descriptor table, growing the table if it is full.
+   Returns the new file descriptor, or -1 if out of memory.  The caller must hold PCB's fd_lock. */
+static int fd_alloc(struct process *pcb, struct file *file) {
+  size_t fd = pcb->fd_map != NULL ? bitmap_scan_and_flip(pcb->fd_map, 0, 1, false) : BITMAP_ERROR;
+  if (fd == BITMAP_ERROR) {
+    if (!fd_table_grow(pcb)) {
+      return -1;
+    }
+    fd = bitmap_scan_and_flip(pcb->fd_map, 0, 1, false);
+    ASSERT(fd != BITMAP_ERROR);
+  }
+  pcb->fd_table[fd] = file;
+  return fd;
 }
 
-void syscall_init(void) {
-  intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init(&file_global_lock); /* Initializing the global file lock.*/
+/* Doubles the size of PCB's file descriptor table, allocating it on first use with fds 0 and 1 reserved for the
+   console.  Returns false, leaving the table unchanged, if out of memory.  The caller must hold PCB's fd_lock. */
+static bool fd_table_grow(struct process *pcb) {
+  size_t new_cnt = pcb->fd_cnt == 0 ? FD_TABLE_MIN : pcb->fd_cnt * 2;
+  struct bitmap *new_map = bitmap_create(new_cnt);
+  if (new_map == NULL) {
+    return false;
+  }
+  struct file **new_table = realloc(pcb->fd_table, new_cnt * sizeof *new_table);
+  if (new_table == NULL) {
+    bitmap_destroy(new_map);
+    return false;
+  }
+
+  if (pcb->fd_map == NULL) {
+    bitmap_mark(new_map, STDIN_FILENO);
+    bitmap_mark(new_map, STDOUT_FILENO);
+  } else {
+    bitmap_set_multiple(new_map, 0, pcb->fd_cnt, true);
+    bitmap_destroy(pcb->fd_map);
+  }
+  memset(new_table + pcb->fd_cnt, 0, (new_cnt - pcb->fd_cnt) * sizeof *new_table);
+
+  pcb->fd_table = new_table;
+  pcb->fd_cnt = new_cnt;
+  pcb->fd_map = new_map;
+  return true;
 }
 
-static void syscall_handler(struct intr_frame* f UNUSED) {
+/* Returns true if the CPU has working SYSENTER and SYSEXIT.
+   Early Pentium Pro parts report them without supporting them.
+   See [IA32-v2b] "SYSENTER". */
+static bool cpu_has_sysenter(void) {
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
 
-  // For debug pruposes
-  struct thread* t = thread_current();
+  cpuid(1, &eax, &ebx, &ecx, &edx);
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return (edx & CPUID_1_EDX_SEP) != 0 && !(family == 6 && model < 3 && stepping < 3);
+}
 
-  lock_acquire(&thread_current()->pcb->syscall_lock);
+void syscall_init(void) {
+  intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall");
+  futex_init();
+
+  /* System calls may also enter through SYSENTER, which skips
+     the interrupt gate and IRET.  int $0x30 keeps working. */
+  if (cpu_has_sysenter()) {
+    wrmsr(MSR_SYSENTER_CS, SEL_KCSEG);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    tss_track_sysenter();
+    vdso_set_sysenter(true);
+  }
+}
+
+/* Number of arguments each system call takes, after its number. */
+static const uint8_t syscall_argc[] = {
+    [SYS_HALT] = 0,          [SYS_EXIT] = 1,         [SYS_EXEC] = 1,
+    [SYS_WAIT] = 1,          [SYS_CREATE] = 2,       [SYS_REMOVE] = 1,
+    [SYS_OPEN] = 1,          [SYS_FILESIZE] = 1,     [SYS_READ] = 3,
+    [SYS_WRITE] = 3,         [SYS_SEEK] = 2,         [SYS_TELL] = 1,
+    [SYS_CLOSE] = 1,         [SYS_PRACTICE] = 1,     [SYS_COMPUTE_E] = 1,
+    [SYS_PT_CREATE] = 3,     [SYS_PT_EXIT] = 0,      [SYS_PT_JOIN] = 1,
+    [SYS_PT_CREATE_MANY] = 5, [SYS_PT_JOIN_ALL] = 2, [SYS_FUTEX_WAIT] = 2,
+    [SYS_FUTEX_WAKE] = 2,    [SYS_GET_TID] = 0,      [SYS_GETRUSAGE] = 2,
+    [SYS_SET_THREAD_AREA] = 1,
+};
+
+/* Most arguments any system call takes. */
+#define SYSCALL_ARGS_MAX 5
 
-  uint32_t* args = ((uint32_t*)f->esp);
+static void syscall_handler(struct intr_frame* f UNUSED) {
+  /* The system call number and its arguments, copied out of the
+     user stack in one go.  The rest of the handler reads only
+     this copy, so a bad stack pointer, or arguments that run off
+     the end of the stack, kill the process here and nowhere
+     else. */
+  uint32_t args[1 + SYSCALL_ARGS_MAX];
+  const uint32_t* uargs = f->esp;
 
-  /** check if the argument is a valid when passing into syscall handler*/
-  if(!is_user_vaddr(args) || !pagedir_get_page(thread_current()->pcb->pagedir,args)){
-    thread_current()->exit = -1;
-    printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
-    process_exit();
-  }
-  if((pg_no(args) != pg_no(args+1)) && 
-(strcmp("sc-boundary-3",thread_current()->name) == 0)){
-    thread_current()->exit = -1;
-    printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
-    process_exit();
+  if (!copy_from_user(&args[0], uargs, sizeof args[0]) ||
+      args[0] >= sizeof syscall_argc / sizeof *syscall_argc ||
+      !copy_from_user(&args[1], uargs + 1, syscall_argc[args[0]] * sizeof *args)) {
+    syscall_kill();
   }
 
   uint32_t syscall_num = args[0];
@@ -144,116 +237,81 @@ static void syscall_handler(struct intr_frame* f UNUSED) {
     case SYS_PT_EXIT:
       syscall_pthread_exit(args,&f->eax);
       break;
+    case SYS_PT_CREATE_MANY:
+      syscall_pthread_create_many(args, &f->eax);
+      break;
+    case SYS_PT_JOIN_ALL:
+      syscall_pthread_join_all(args, &f->eax);
+      break;
     case SYS_CREATE:
-      lock_acquire(&file_global_lock);
       syscall_create(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_REMOVE:
-      lock_acquire(&file_global_lock);
       syscall_remove(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_OPEN:
-      lock_acquire(&file_global_lock);
       syscall_open(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_FILESIZE:
-      lock_acquire(&file_global_lock);
       syscall_filesize(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_READ:
-      lock_acquire(&file_global_lock);
       syscall_read(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_WRITE:
-      lock_acquire(&file_global_lock);
       syscall_write(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_SEEK:
-      lock_acquire(&file_global_lock);
       syscall_seek(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_TELL:
-      lock_acquire(&file_global_lock);
       syscall_tell(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_CLOSE:
-      lock_acquire(&file_global_lock);
       syscall_close(args, &f->eax);
-      lock_release(&file_global_lock);
       break;
     case SYS_COMPUTE_E:
       f->eax = sys_compute_e(args[1]);
       break;
-    case SYS_LOCK_INIT:
-      syscall_lock_init(args, &f->eax);
-      break;
-    case SYS_LOCK_ACQUIRE:
-      syscall_lock_acquire(args, &f->eax);
+    case SYS_FUTEX_WAIT:
+      syscall_futex_wait(args, &f->eax);
       break;
-    case SYS_LOCK_RELEASE:
-      syscall_lock_release(args, &f->eax);
+    case SYS_FUTEX_WAKE:
+      syscall_futex_wake(args, &f->eax);
       break;
-    case SYS_SEMA_INIT:
-      syscall_sema_init(args, &f->eax);
+    case SYS_GETRUSAGE:
+      syscall_getrusage(args, &f->eax);
       break;
-    case SYS_SEMA_UP:
-      syscall_sema_up(args, &f->eax);
+    case SYS_GET_TID:
+      syscall_get_tid(args, &f->eax);
       break;
-    case SYS_SEMA_DOWN:
-      syscall_sema_down(args, &f->eax);
+    case SYS_SET_THREAD_AREA:
+      syscall_set_thread_area(args, &f->eax);
       break;
     default:
-      syscall_exit(args, &f->eax);
+      syscall_kill();
   }
-
-  lock_release(&thread_current()->pcb->syscall_lock);
 }
 
-static int validate_syscall_arg(uint32_t *args UNUSED, int args_count){
-  /** 
-    Validate `args_count` number of argument under `args` and check for:
-      1. Null Pointer
-      2. Whether the addr is in memory or not
-      3. Whether the address is in page table.
-  */ 
-  int is_valid = 1;
-  for(int i = 0; i < args_count + 1; i++){
-    if (args == NULL){
-      // whether the pointer is NULL pointer.
-      is_valid = 0;
-      break;
-    }
-    if (!is_user_vaddr(args)){
-      // whether the pointer is in user address.
-      is_valid = 0;
-      break;
-    }
-    if (!pagedir_get_page(thread_current()->pcb->pagedir,args)){
-      // whether the pointer is unmapped in page table. 
-      is_valid = 0;
-      break;
-    }
-    args++;
-  }
-  return is_valid;
+/* Terminates the calling process with exit status -1, for a
+   system call with a bad argument. */
+static void syscall_kill(void) {
+  thread_current()->exit = -1;
+  printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
+  process_exit();
+  NOT_REACHED();
 }
 
-static void validate_str_arg(char **arg UNUSED){
-    char *cmd_str_ptr = *arg;
-    cmd_str_ptr += 4;
-    if(!is_user_vaddr(cmd_str_ptr)){
-      thread_current()->exit = -1;
-      printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
-      process_exit();
-    }
+/* Copies the file name at user address UNAME into NAME, which
+   holds NAME_BUF_SIZE bytes.  Returns false if the name is too
+   long to be the name of any file.  Kills the process if the
+   name is not in readable user memory. */
+static bool copy_name(char *name, const char *uname) {
+  int len = strncpy_from_user(name, uname, NAME_BUF_SIZE);
+  if (len < 0) {
+    syscall_kill();
+  }
+  return len < NAME_BUF_SIZE;
 }
 
 static void syscall_halt(uint32_t *args UNUSED, uint32_t *eax UNUSED){
@@ -261,60 +319,33 @@ static void syscall_halt(uint32_t *args UNUSED, uint32_t *eax UNUSED){
 }
 
 static void syscall_exit (uint32_t *args UNUSED, uint32_t *eax UNUSED){
-  if (!validate_syscall_arg(args,1)){
-    thread_current()->exit = -1;
-    printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
-    process_exit();
-  }
   *eax = args[1];
   printf("%s: exit(%d)\n", thread_current()->pcb->process_name, args[1]);
   thread_current()->exit = args[1];
 
-  if (lock_held_by_current_thread(&file_global_lock)) {
-    lock_release(&file_global_lock);
-  }
-
   process_exit();
 }
 
 static void syscall_exec(uint32_t *args UNUSED, uint32_t *eax UNUSED){
-  if ((pg_no(args+1) != pg_no(args+2)) || ((pg_no(*(args+1)) != pg_no(*(args+2)) && ((char*)*(args+1) == 0x804efff)))){
-    thread_current()->exit = -1;
-    printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
-    process_exit();
+  char *cmd_line = palloc_get_page(0);
+  if (cmd_line == NULL) {
+    *eax = -1;
+    return;
   }
-  if (!validate_syscall_arg(args,1) || !validate_syscall_arg((uint32_t)args[1],1) || args[1] == NULL){
-    thread_current()->exit = -1;
-    printf("%s: exit(%d)\n", thread_current()->pcb->process_name, -1);
-    process_exit();
+  int len = strncpy_from_user(cmd_line, (const char *) args[1], PGSIZE);
+  if (len < 0) {
+    palloc_free_page(cmd_line);
+    syscall_kill();
   }
-  lock_acquire(&file_global_lock);
-  *eax = process_execute((char*) args[1]);
-  lock_release(&file_global_lock);
+  *eax = len < PGSIZE ? process_execute(cmd_line) : -1;
+  palloc_free_page(cmd_line);
 }
 
 static void syscall_wait(uint32_t *args UNUSED, uint32_t *eax UNUSED){
-  if (!validate_syscall_arg(args,1)){
-    args[1] = -1;
-    thread_current()->exit = -1;
-    syscall_exit(args,eax);
-  }
-  int lock_held = lock_held_by_current_thread(&file_global_lock);
-  if (lock_held) {
-    lock_release(&file_global_lock);
-  }
   *eax = process_wait(args[1]);
-  if (lock_held) {
-    lock_acquire(&file_global_lock);
-  }
 }
 
 static void syscall_practice(uint32_t *args UNUSED, uint32_t *eax UNUSED){
-  if (!validate_syscall_arg(args,1)){
-    args[1] = -1;
-    thread_current()->exit = -1;
-    syscall_exit(args,eax);
-  }
   int i = (int)args[1];
   *eax = i + 1;
 }
@@ -322,145 +353,113 @@ static void syscall_practice(uint32_t *args UNUSED, uint32_t *eax UNUSED){
 int sys_compute_e(int n) { return sys_sum_to_e(n); }
 
 static void syscall_create(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (args[1] == NULL || check_bad_pointer(&args[1]) || check_bad_pointer((char *) args[1])) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-  } else {
-    *eax = filesys_create((char *) args[1], (unsigned) args[2]);
-  }
+  char name[NAME_BUF_SIZE];
+  *eax = copy_name(name, (const char *) args[1]) && filesys_create(name, (unsigned) args[2]);
 }
 
 static void syscall_remove(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (args[1] == NULL || check_bad_pointer(&args[1]) || check_bad_pointer((char *) args[1])) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
-  *eax = filesys_remove((char *) args[1]);
+  char name[NAME_BUF_SIZE];
+  *eax = copy_name(name, (const char *) args[1]) && filesys_remove(name);
 }
 
 static void syscall_open(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (args[1] == NULL || check_bad_pointer(&args[1]) || check_bad_pointer((char *) args[1])) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
-  *eax = open((char *) args[1]);
+  char name[NAME_BUF_SIZE];
+  *eax = copy_name(name, (const char *) args[1]) ? open(name) : -1;
 }
 
 static void syscall_filesize(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2) || args[1] == NULL) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
   *eax = filesize((int) args[1]);
 }
 
 static void syscall_read(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 4) || check_bad_pointer(&args[2]) || check_bad_pointer((char *) args[2]) || check_bad_pointer((char *) args[2] + args[3])) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+  if (!is_user_range((void *) args[2], args[3])) {
+    syscall_kill();
   }
   *eax = read((int) args[1], (void *) args[2], (unsigned int) args[3]);
 }
 
 static void syscall_write(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 4) || check_bad_pointer(&args[2]) || check_bad_pointer((char *) args[2]) || check_bad_pointer((char *) args[2] + args[3])) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+  if (!is_user_range((void *) args[2], args[3])) {
+    syscall_kill();
   }
   *eax = write((int) args[1], (void *) args[2], (unsigned int) args[3]);
 }
 
 static void syscall_seek(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 3)) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
   seek((int) args[1], (unsigned int) args[2]);
 }
 
 static void syscall_tell(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 3)) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
   int position = tell((int) args[1]);
   if (position == -1) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+    syscall_kill();
   }
   *eax = position;
 }
 
 static void syscall_close(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2) || close((int) args[1]) == -1) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+  if (close((int) args[1]) == -1) {
+    syscall_kill();
   }
 }
 
-static void syscall_lock_init(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2)) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
-  *eax = sys_lock_init((lock_t *) args[1]);
+/* Futex arguments are the address of an aligned int in user
+   memory, so it cannot straddle a page boundary.  futex_wait()
+   copes with the page not being mapped. */
+static bool futex_addr_valid(int *uaddr) {
+  return ((uintptr_t) uaddr & (sizeof *uaddr - 1)) == 0 && is_user_range(uaddr, sizeof *uaddr);
 }
 
-static void syscall_lock_acquire(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2) || args[1] == NULL) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+static void syscall_futex_wait(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  struct thread *cur = thread_current();
+  if (!futex_addr_valid((int *) args[1])) {
+    syscall_kill();
   }
-  *eax = sys_lock_acquire((lock_t *) args[1]);
+  *eax = futex_wait(cur->pcb, (int *) args[1], (int) args[2]);
 }
 
-static void syscall_lock_release(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2) || args[1] == NULL) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+static void syscall_futex_wake(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  if (!futex_addr_valid((int *) args[1])) {
+    syscall_kill();
   }
-  *eax = sys_lock_release((lock_t *) args[1]);
+  *eax = futex_wake(thread_current()->pcb, (int *) args[1], (int) args[2]);
 }
 
-static void syscall_sema_init(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 3)) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
+static void syscall_getrusage(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  struct rusage usage;
+  memset(&usage, 0, sizeof usage);
+  *eax = sys_getrusage((int) args[1], &usage);
+  if (!copy_to_user((struct rusage *) args[2], &usage, sizeof usage)) {
+    syscall_kill();
   }
-  *eax = sys_sema_init((sema_t*) args[1], (int) args[2]);
 }
 
-static void syscall_sema_up(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2) || args[1] == NULL) {
-    args[1] = -1;
-    syscall_exit(args, eax);
-    return;
-  }
-  *eax = sys_sema_up((sema_t*) args[1]);
+static void syscall_get_tid(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  *eax = thread_current()->tid;
 }
 
-static void syscall_sema_down(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
-  if (!validate_syscall_arg(args, 2) || args[1] == NULL) {
-    args[1] = -1;
-    syscall_exit(args, eax);
+/* Makes the calling thread's GS segment start at user address
+   args[1], so that the thread can reach its own data with
+   GS-relative loads.  The segment is reloaded on the way back to
+   user mode, and process_activate() restores it on every switch
+   to this thread.  Returns 0, or -1 if the address is not in
+   user space. */
+static void syscall_set_thread_area(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+
+  if (!is_user_vaddr((void *) args[1])) {
+    *eax = -1;
     return;
   }
-  *eax = sys_sema_down((sema_t*) args[1]);
-}
 
+  /* A switch between the two updates would load the old base. */
+  old_level = intr_disable();
+  cur->tls_base = args[1];
+  gdt_set_tls(cur->tls_base);
+  intr_set_level(old_level);
+  *eax = 0;
+}
 
 /* ================================================================================
  * Helper functions for some of the above syscall() functions.
@@ -474,60 +473,82 @@ static void syscall_sema_down(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
    open should never return either of these file descriptors, which are valid as
    system call arguments only as explicitly described below. */
 int open(const char *file) {
-  struct file_desc_entry *new_fde = malloc(sizeof(struct file_desc_entry));
   struct file *requested_file = filesys_open(file);
-  if (requested_file == NULL || new_fde == NULL) {
+  if (requested_file == NULL) {
     return -1;
   }
-  
-  struct thread *t = thread_current();
-
-  new_fde->fd = t->pcb->next_available_fd;
-  new_fde->file_name = file;
-  new_fde->fptr = requested_file;
-  
-  list_push_back(&t->pcb->file_desc_entry_list, &new_fde->elem);
 
-  // Find a way to insert in the right place even with gaps in fds.
-  find_next_available_fd();
-  return new_fde->fd;
+  struct process *pcb = thread_current()->pcb;
+  lock_acquire(&pcb->fd_lock);
+  int fd = fd_alloc(pcb, requested_file);
+  lock_release(&pcb->fd_lock);
+  if (fd == -1) {
+    file_close(requested_file);
+  }
+  return fd;
 }
 
 /* Returns the size, in bytes, of the open file with file descriptor fd.
    Returns -1 if fd does not correspond to an entry in the file descriptor table. */
 int filesize(int fd) {
-  struct file_desc_entry *entry = find_entry_by_fd(fd);
-  if (entry == NULL) {
+  struct file *file = get_file_by_fd(fd);
+  if (file == NULL) {
     return -1;
   }
 
-  struct file *file = entry->fptr;
-  return file_length(file);
+  int length = file_length(file);
+  file_close(file);
+  return length;
 }
 
 /* Reads size bytes from the file open as fd into buffer.
    Returns the number of bytes actually read (0 at end of file),
    or -1 if the file could not be read (due to a condition other than end of file,
    such as fd not corresponding to an entry in the file descriptor table).
-   STDIN_FILENO reads from the keyboard using the input_getc function in devices/input.c. */
+   STDIN_FILENO reads from the keyboard using the input_getc function in devices/input.c.
+
+   buffer is a user address.  The file system only reads into kernel memory, so the data goes through a bounce
+   page a page at a time.  Kills the process if buffer is not writable. */
 int read(int fd, void *buffer, unsigned size) {
+  uint8_t *ubuf = buffer;
   if (fd == STDIN_FILENO) {
-    size_t i = 0;
-    uint8_t *buffer_c = (uint8_t *) buffer;
-    while (i < size) {
-      buffer_c[i] = input_getc();
-      if (buffer_c[i + 1] == '\n') {
-        break;
+    for (unsigned i = 0; i < size; i++) {
+      uint8_t c = input_getc();
+      if (!copy_to_user(ubuf + i, &c, 1)) {
+        syscall_kill();
       }
     }
-    return i;
+    return size;
   }
-  struct file_desc_entry *entry = find_entry_by_fd(fd);
-  if (entry == NULL) {
+  struct file *file = get_file_by_fd(fd);
+  if (file == NULL) {
     return -1;
   }
-  struct file *file = entry->fptr;
-  int read_bytes = file_read(file, buffer, size);
+  uint8_t *bounce = palloc_get_page(0);
+  if (bounce == NULL) {
+    file_close(file);
+    return -1;
+  }
+
+  int read_bytes = 0;
+  bool fault = false;
+  while ((unsigned) read_bytes < size) {
+    int chunk = size - read_bytes < PGSIZE ? (int) (size - read_bytes) : PGSIZE;
+    int n = file_read(file, bounce, chunk);
+    if (!copy_to_user(ubuf + read_bytes, bounce, n)) {
+      fault = true;
+      break;
+    }
+    read_bytes += n;
+    if (n < chunk) {
+      break;
+    }
+  }
+  palloc_free_page(bounce);
+  file_close(file);
+  if (fault) {
+    syscall_kill();
+  }
   return read_bytes;
 }
 
@@ -535,48 +556,81 @@ int read(int fd, void *buffer, unsigned size) {
    Returns the number of bytes actually written, which may be less than size if some bytes could not be written.
    Returns -1 if fd does not correspond to an entry in the file descriptor table.
 
-   File descriptor 1 writes to the console. */
+   File descriptor 1 writes to the console.
+
+   buffer is a user address, copied through a bounce page as in read().  Kills the process if buffer is not
+   readable. */
 int write(int fd, const void *buffer, unsigned size) {
   if (buffer == NULL) {
     return -1;
   }
-  if (fd == STDOUT_FILENO) {
-    const char *c_buffer = (const char*) buffer;
-    putbuf(c_buffer, size);
-    return 0;
+  struct file *file = NULL;
+  if (fd != STDOUT_FILENO) {
+    file = get_file_by_fd(fd);
+    if (file == NULL) {
+      return -1;
+    }
   }
-
-  struct file_desc_entry *entry = find_entry_by_fd(fd);
-  if (entry == NULL) {
+  uint8_t *bounce = palloc_get_page(0);
+  if (bounce == NULL) {
+    if (file != NULL) {
+      file_close(file);
+    }
     return -1;
   }
-  struct file *file = entry->fptr;
-  int written_bytes = file_write(file, buffer, size);
-  return written_bytes;
+
+  const uint8_t *ubuf = buffer;
+  int written_bytes = 0;
+  bool fault = false;
+  while ((unsigned) written_bytes < size) {
+    int chunk = size - written_bytes < PGSIZE ? (int) (size - written_bytes) : PGSIZE;
+    if (!copy_from_user(bounce, ubuf + written_bytes, chunk)) {
+      fault = true;
+      break;
+    }
+    if (file == NULL) {
+      putbuf((const char *) bounce, chunk);
+      written_bytes += chunk;
+      continue;
+    }
+    int n = file_write(file, bounce, chunk);
+    written_bytes += n;
+    if (n < chunk) {
+      break;
+    }
+  }
+  palloc_free_page(bounce);
+  if (file != NULL) {
+    file_close(file);
+  }
+  if (fault) {
+    syscall_kill();
+  }
+  return file != NULL ? written_bytes : 0;
 }
 
 /* Changes the next byte to be read or written in open file fd to position,
    expressed in bytes from the beginning of the file. Thus, a position of 0 is the file’s start.
    If fd does not correspond to an entry in the file descriptor table, this function should do nothing. */
 void seek(int fd, unsigned position) {
-  struct file_desc_entry *entry = find_entry_by_fd(fd);
-  if (entry == NULL) {
+  struct file *file = get_file_by_fd(fd);
+  if (file == NULL) {
     return;
   }
-  struct file *file = entry->fptr;
   file_seek(file, position);
+  file_close(file);
 }
 
 /* Returns the position of the next byte to be read or written in open file fd,
    expressed in bytes from the beginning of the file.
    Returns -1 if fd does not correspond to an entry in the file descriptor table. */
 unsigned tell(int fd) {
-  struct file_desc_entry *entry = find_entry_by_fd(fd);
-  if (entry == NULL) {
+  struct file *file = get_file_by_fd(fd);
+  if (file == NULL) {
     return -1;
   }
-  struct file *file = entry->fptr;
   unsigned told_bytes = (unsigned) file_tell(file);
+  file_close(file);
   return told_bytes;
 }
 
@@ -585,96 +639,41 @@ unsigned tell(int fd) {
    as if by calling this function for each one.
    Returns -1 if fd does not correspond to an entry in the file descriptor table. */
 int close(int fd) {
-  struct file_desc_entry *entry = find_entry_by_fd(fd);
-  if (entry == NULL) {
+  struct process *pcb = thread_current()->pcb;
+  lock_acquire(&pcb->fd_lock);
+  struct file *file = lookup_fd(pcb, fd);
+  if (file == NULL) {
+    lock_release(&pcb->fd_lock);
     return -1;
   }
-  struct file *file = entry->fptr;
-  list_remove(&entry->elem);
-  free(entry);
+  pcb->fd_table[fd] = NULL;
+  bitmap_reset(pcb->fd_map, fd);
+  lock_release(&pcb->fd_lock);
   file_close(file);
   return 0;
 }
 
-/* Initializes a user lock by creating a new user_lock_entry and adding to the PCB list. */
-int sys_lock_init(lock_t* lock) {
-  if (lock == NULL) {
-    return 0;
-  }
-  struct user_lock_entry *new_user_lock = malloc(sizeof(struct user_lock_entry));
-  if (new_user_lock == NULL) {
-    return 0;
-  }
-  new_user_lock->user_lock_id = lock;
-  lock_init(&new_user_lock->lock);
-  list_push_back(&thread_current()->pcb->user_locks, &new_user_lock->elem);
-  return 1;
-}
-
-/* Attempts to acquire a user lock. */
-int sys_lock_acquire(lock_t *lock) {
-  struct list_elem *e;
-  for (e = list_begin(&thread_current()->pcb->user_locks); e != list_end(&thread_current()->pcb->user_locks); e = list_next(e)) {
-    struct user_lock_entry *entry = list_entry(e, struct user_lock_entry, elem);
-    if (entry->user_lock_id == lock && !lock_held_by_current_thread(&entry->lock)) {
-      lock_acquire(&entry->lock);
-      return 1;
-    }
-  }
-  return 0;
-}
-
-/* Attempts to release a user lock. */
-int sys_lock_release(lock_t *lock) {
-  struct list_elem *e;
-  for (e = list_begin(&thread_current()->pcb->user_locks); e != list_end(&thread_current()->pcb->user_locks); e = list_next(e)) {
-    struct user_lock_entry *entry = list_entry(e, struct user_lock_entry, elem);
-    if (entry->user_lock_id == lock && lock_held_by_current_thread(&entry->lock)) {
-      lock_release(&entry->lock);
-      return 1;
-    }
-  }
-  return 0;
-}
-
-/* Attempts to initialize a user semaphore. */
-int sys_sema_init(sema_t* sema, int val) {
-  if (sema == NULL || val < 0) {
-    return 0;
-  }
-  struct user_sema_entry *new_user_sema = malloc(sizeof(struct user_sema_entry));
-  if (new_user_sema == NULL) {
-    return 0;
-  }
-  new_user_sema->user_sema_id = sema;
-  sema_init(&new_user_sema->sema, val);
-  list_push_back(&thread_current()->pcb->user_semaphores, &new_user_sema->elem);
-  return 1;
-}
-
-/* Attempts to raise a user semaphore's value up one value. */
-int sys_sema_up(sema_t* sema) {
-  struct list_elem *e;
-  for (e = list_begin(&thread_current()->pcb->user_semaphores); e != list_end(&thread_current()->pcb->user_semaphores); e = list_next(e)) {
-    struct user_sema_entry *entry = list_entry(e, struct user_sema_entry, elem);
-    if (entry->user_sema_id == sema) {
-      sema_up(&entry->sema);
-      return 1;
-    }
+/* Fills in USAGE with the CPU usage of the calling thread (WHO is RUSAGE_THREAD)
+   or of its whole process (WHO is RUSAGE_SELF).
+   Returns 0 on success, or -1 if WHO is invalid. */
+int sys_getrusage(int who, struct rusage* usage) {
+  struct cpu_usage cu;
+  if (who == RUSAGE_SELF) {
+    process_get_usage(thread_current()->pcb, &cu);
+  } else if (who == RUSAGE_THREAD) {
+    thread_get_usage(thread_current(), &cu);
+  } else {
+    return -1;
   }
-  return 0;
-}
 
-/* Attempts to lower a user semaphore's value down one value. */
-int sys_sema_down(sema_t* sema) {
-  struct list_elem *e;
-  for (e = list_begin(&thread_current()->pcb->user_semaphores); e != list_end(&thread_current()->pcb->user_semaphores); e = list_next(e)) {
-    struct user_sema_entry *entry = list_entry(e, struct user_sema_entry, elem);
-    if (entry->user_sema_id == sema) {
-      sema_down(&entry->sema);
-      return 1;
-    }
-  }
+  usage->utime_cycles = cu.user_cycles;
+  usage->stime_cycles = cu.kernel_cycles;
+  usage->lock_wait_cycles = cu.lock_wait_cycles;
+  usage->utime_ns = timer_tsc_to_ns(cu.user_cycles);
+  usage->stime_ns = timer_tsc_to_ns(cu.kernel_cycles);
+  usage->lock_wait_ns = timer_tsc_to_ns(cu.lock_wait_cycles);
+  usage->nvcsw = cu.nvcsw;
+  usage->nivcsw = cu.nivcsw;
   return 0;
 }
 
@@ -690,16 +689,45 @@ static void syscall_pthread_exit(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
   pthread_exit();
 }
 
-/* ======================================================================================== */
-/* Checks whether the given pointer is a bad pointer relative to the current user process. */
-int check_bad_pointer(void *addr) {
-  if (!is_user_vaddr(addr)) {
-    return 1;
-  } else if (!pagedir_get_page(thread_current()->pcb->pagedir, addr)) {
-    return 1;
-  } else if (addr == NULL) {
-    return 1;
+/* Creates up to n threads running tf(args[i]) through stub sf, writing
+   their tids to tids[], and returns how many were created.  Stops at the
+   first failure, as n separate pthread_create() calls would. */
+static void syscall_pthread_create_many(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  void **uthread_args = (void **) args[3];
+  int n = (int) args[4];
+  tid_t *utids = (tid_t *) args[5];
+  void *thread_args[MAX_THREADS];
+  if (n < 0 || n > MAX_THREADS || !copy_from_user(thread_args, uthread_args, n * sizeof *thread_args) ||
+      !is_user_range(utids, n * sizeof *utids)) {
+    syscall_kill();
+  }
+
+  int created;
+  for (created = 0; created < n; created++) {
+    tid_t tid = pthread_execute((stub_fun) args[1], (pthread_fun) args[2], thread_args[created]);
+    if (!copy_to_user(&utids[created], &tid, sizeof tid)) {
+      syscall_kill();
+    }
+    if (tid == TID_ERROR) {
+      break;
+    }
   }
-  return 0;
+  *eax = created;
 }
 
+/* Joins each of the n threads in tids[] and returns how many were joined. */
+static void syscall_pthread_join_all(uint32_t *args UNUSED, uint32_t *eax UNUSED) {
+  tid_t tids[MAX_THREADS];
+  int n = (int) args[2];
+  if (n < 0 || n > MAX_THREADS || !copy_from_user(tids, (const tid_t *) args[1], n * sizeof *tids)) {
+    syscall_kill();
+  }
+
+  int joined = 0;
+  for (int i = 0; i < n; i++) {
+    if (pthread_join(tids[i]) != TID_ERROR) {
+      joined++;
+    }
+  }
+  *eax = joined;
+}
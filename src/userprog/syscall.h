@@ -3,5 +3,9 @@
 
 void syscall_init(void);
 
+/* Fast system call entry points, in sysenter.S. */
+void sysenter_entry(void);
+void sysenter_entry_traced(void);
+
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -74,6 +75,10 @@ struct tss {
 /* Kernel TSS. */
 static struct tss* tss;
 
+/* True once SYSENTER is in use, whose stack pointer must follow
+   esp0. */
+static bool track_sysenter;
+
 /* Initializes the kernel TSS. */
 void tss_init(void) {
   /* Our TSS is never used in a call gate or task gate, so only a
@@ -96,4 +101,13 @@ struct tss* tss_get(void) {
 void tss_update(void) {
   ASSERT(tss != NULL);
   tss->esp0 = (uint8_t*)thread_current() + PGSIZE;
+  if (track_sysenter)
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)tss->esp0);
+}
+
+/* Makes tss_update() also point SYSENTER at the current thread's
+   kernel stack, starting now. */
+void tss_track_sysenter(void) {
+  track_sysenter = true;
+  tss_update();
 }
@@ -0,0 +1,71 @@
+#include "userprog/usercopy.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Copying between kernel and user memory.
+
+   These functions check only that a user range lies below
+   PHYS_BASE, and then simply attempt the access.  Kernel accesses
+   to a user page that is unmapped, or read-only when writing,
+   page fault; page_fault() looks up the faulting instruction
+   with usercopy_fixup() and makes the copy return failure.  This
+   costs nothing for the common case of good pointers, and unlike
+   checking page tables beforehand it cannot be raced by another
+   thread of the process. */
+
+/* In uaccess.S. */
+size_t usercopy_copy(void* dst, const void* src, size_t size);
+int usercopy_strncpy(char* dst, const char* src, size_t size);
+extern const struct usercopy_fixup usercopy_fixups[];
+extern const struct usercopy_fixup usercopy_fixups_end[];
+
+/* Returns true if the SIZE bytes starting at UADDR all lie in
+   user virtual memory.  Says nothing about whether they are
+   mapped. */
+bool is_user_range(const void* uaddr, size_t size) {
+  uintptr_t start = (uintptr_t)uaddr;
+  return start + size >= start && start + size <= (uintptr_t)PHYS_BASE;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns
+   false if any of the source is not readable user memory, in
+   which case DST may have been partly written. */
+bool copy_from_user(void* dst, const void* usrc, size_t size) {
+  return is_user_range(usrc, size) && usercopy_copy(dst, usrc, size) == 0;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns
+   false if any of the destination is not writable user memory,
+   in which case a prefix of it may have been written. */
+bool copy_to_user(void* udst, const void* src, size_t size) {
+  return is_user_range(udst, size) && usercopy_copy(udst, src, size) == 0;
+}
+
+/* Copies the null-terminated string at user address USRC,
+   including the null, into DST, which holds SIZE bytes.
+   Returns the length of the string, SIZE if it does not fit in
+   DST (which is then not null-terminated), or -1 if it is not
+   entirely in readable user memory. */
+int strncpy_from_user(char* dst, const char* usrc, size_t size) {
+  size_t room;
+  int len;
+
+  if (!is_user_vaddr(usrc))
+    return -1;
+
+  /* A string that runs into kernel space is bad. */
+  room = (uint8_t*)PHYS_BASE - (const uint8_t*)usrc;
+  if (size <= room)
+    return usercopy_strncpy(dst, usrc, size);
+  len = usercopy_strncpy(dst, usrc, room);
+  return len == (int)room ? -1 : len;
+}
+
+/* Returns the address to resume at for a page fault at kernel
+   instruction INSN, or NULL if INSN is not in the fixup table. */
+void* usercopy_fixup(void* insn) {
+  for (const struct usercopy_fixup* f = usercopy_fixups; f < usercopy_fixups_end; f++)
+    if (f->insn == insn)
+      return f->resume;
+  return NULL;
+}
@@ -0,0 +1,21 @@
+#ifndef USERPROG_USERCOPY_H
+#define USERPROG_USERCOPY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A kernel instruction that may fault on a user address, and the
+   address to resume at if it does.  See uaccess.S. */
+struct usercopy_fixup {
+  void* insn;
+  void* resume;
+};
+
+bool is_user_range(const void* uaddr, size_t size);
+bool copy_from_user(void* dst, const void* usrc, size_t size);
+bool copy_to_user(void* udst, const void* src, size_t size);
+int strncpy_from_user(char* dst, const char* usrc, size_t size);
+
+void* usercopy_fixup(void* insn);
+
+#endif /* userprog/usercopy.h */
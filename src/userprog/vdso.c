@@ -0,0 +1,67 @@
+#include "userprog/vdso.h"
+#include <debug.h>
+#include <vdso.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "userprog/pagedir.h"
+
+/* The vDSO data page.
+
+   One page of kernel data is shared read-only by every process
+   at VDSO_ADDR, so that user programs can read the time and
+   their TID with plain loads instead of system calls.  The
+   kernel writes it through its own mapping: the tick count from
+   the timer interrupt, the TSC calibration once at boot, and the
+   running thread's TID on every thread switch.
+
+   TICKS is 64 bits wide, so a reader could see half of an
+   update.  It is guarded by a sequence count that is odd during
+   an update: readers retry if the count was odd or changed while
+   they read.  The other fields are single aligned words or are
+   written before any process exists. */
+static struct vdso_data* vdso;
+
+/* Allocates the vDSO data page. */
+void vdso_init(void) {
+  vdso = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  vdso->timer_freq = TIMER_FREQ;
+}
+
+/* Maps the vDSO data page read-only into page directory PD.
+   Returns false if something else is already mapped there or
+   memory allocation fails. */
+bool vdso_map(uint32_t* pd) {
+  void* upage = (void*)VDSO_ADDR;
+  return pagedir_get_page(pd, upage) == NULL && pagedir_set_page(pd, upage, vdso, false);
+}
+
+/* Removes the vDSO data page from PD, which must be done before
+   destroying PD so that the shared page is not freed with it. */
+void vdso_unmap(uint32_t* pd) { pagedir_clear_page(pd, (void*)VDSO_ADDR); }
+
+/* Publishes TICKS as the timer tick count.  Called from the
+   timer interrupt. */
+void vdso_set_ticks(int64_t ticks) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  vdso->seq++;
+  barrier();
+  vdso->ticks = ticks;
+  barrier();
+  vdso->seq++;
+}
+
+/* Publishes the time-stamp counter calibration. */
+void vdso_set_tsc(uint64_t tsc_khz, uint64_t tsc_boot) {
+  vdso->tsc_khz = tsc_khz;
+  vdso->tsc_boot = tsc_boot;
+}
+
+/* Publishes TID as the running thread's.  Called on every
+   thread switch. */
+void vdso_set_tid(int tid) { vdso->tid = tid; }
+
+/* Publishes whether system calls may enter by SYSENTER. */
+void vdso_set_sysenter(bool sysenter) { vdso->sysenter = sysenter; }
@@ -0,0 +1,16 @@
+#ifndef USERPROG_VDSO_H
+#define USERPROG_VDSO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void vdso_init(void);
+bool vdso_map(uint32_t* pd);
+void vdso_unmap(uint32_t* pd);
+
+void vdso_set_ticks(int64_t ticks);
+void vdso_set_tsc(uint64_t tsc_khz, uint64_t tsc_boot);
+void vdso_set_tid(int tid);
+void vdso_set_sysenter(bool sysenter);
+
+#endif /* userprog/vdso.h */